@@ -0,0 +1,96 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Random-access latency of Safe_Array::at over a large table, with the
+// entry block on normal pages and on 2 MB pages (Safe_Huge_Page_Resource).
+// Each element holds the index of the next one to visit (a single random
+// cycle through every slot), so every at() is a dependent, cache- and
+// usually TLB-missing load.
+//
+//   g++ -std=c++17 -O2 -pthread -I.. huge_pages.cpp -o huge_pages
+//   ./huge_pages [slots = 33554432] [hops = 20000000]
+//
+// Explicit huge pages need a reservation (vm.nr_hugepages); without one the
+// resource falls back to transparent huge pages, which need THP set to
+// "madvise" or "always".
+
+#include "safe_array.h"
+#include "safe_huge_pages.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+#include <random>
+#include <vector>
+
+using Table = Safe_Array<std::uint32_t, Safe_Dynamic_Capacity>;
+using Clock = std::chrono::steady_clock;
+
+static double ms_since(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void run(const char* name, std::pmr::memory_resource* resource,
+  const std::vector<std::uint32_t>& next, std::size_t hops)
+{
+  auto start = Clock::now();
+  Table table(next.size(), resource);
+  double setup = ms_since(start);
+
+  for (std::uint32_t n : next)
+  {
+    table.insert(n);
+  }
+
+  start = Clock::now();
+  std::size_t idx = 0;
+
+  for (std::size_t i = 0; i < hops; ++i)
+  {
+    idx = table.at(idx)->value;
+  }
+
+  double chase = ms_since(start);
+
+  std::printf("%-16s setup %8.1f ms   %6.1f ns/at   (end %zu)\n",
+    name, setup, chase * 1e6 / double(hops), idx);
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t slots = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : std::size_t(1) << 25;
+  std::size_t hops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000000;
+
+  // Sattolo's shuffle: one cycle through all slots. Inserts into a fresh
+  // array fill slots in index order, so element i lands in slot i.
+  std::vector<std::uint32_t> next(slots);
+  std::mt19937_64 rng(42);
+
+  for (std::size_t i = 0; i < slots; ++i)
+  {
+    next[i] = std::uint32_t(i);
+  }
+
+  for (std::size_t i = slots - 1; i > 0; --i)
+  {
+    std::swap(next[i], next[std::uniform_int_distribution<std::size_t>(0, i - 1)(rng)]);
+  }
+
+  std::printf("%zu slots, %zu hops\n", slots, hops);
+
+  run("4K pages", std::pmr::new_delete_resource(), next, hops);
+
+  Safe_Huge_Page_Resource huge({ false });
+  run("2M pages", &huge, next, hops);
+
+  Safe_Huge_Page_Resource prefaulted({ true });
+  run("2M + prefault", &prefaulted, next, hops);
+
+  std::printf("hugetlb %zu MB, THP fallback %zu MB\n",
+    (huge.hugetlb_bytes() + prefaulted.hugetlb_bytes()) >> 20,
+    (huge.fallback_bytes() + prefaulted.fallback_bytes()) >> 20);
+}
@@ -0,0 +1,122 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Random lookups into an out-of-cache Safe_Array in batches of 256 indices:
+// at() in a loop (one miss at a time) against at_many and visit_many (a
+// window of misses in flight).
+//
+//   g++ -std=c++17 -O2 -I.. multi_get.cpp -o multi_get
+//   ./multi_get [batches = 200000]
+
+#include "safe_array.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+
+struct Row
+{
+  std::uint64_t key;
+  unsigned char rest[56];
+};
+
+// About 512 MB of entries: far past the last-level cache
+constexpr std::size_t SLOTS = (std::size_t(512) << 20) / 96;
+constexpr std::size_t BATCH = 256;
+
+using Table = Safe_Array<Row, SLOTS>;
+using Clock = std::chrono::steady_clock;
+
+template<typename Func>
+static double ns_per_lookup(std::size_t batches, Func f)
+{
+  auto start = Clock::now();
+
+  for (std::size_t b = 0; b < batches; ++b)
+  {
+    f(b);
+  }
+
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / double(batches * BATCH);
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t batches = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+
+  auto table = std::make_unique<Table>();
+
+  for (std::size_t i = 0; i < SLOTS; ++i)
+  {
+    table->insert(Row{ i, {} });
+  }
+
+  // A pool of random batches, reused round-robin
+  constexpr std::size_t POOL = 1024;
+  std::vector<std::size_t> indices(POOL * BATCH);
+  std::mt19937_64 rng(3);
+
+  for (auto& i : indices)
+  {
+    i = std::size_t(rng() % SLOTS);
+  }
+
+  std::vector<std::optional<Table::Op_Result>> out(BATCH);
+  volatile std::uint64_t sink = 0;
+
+  double loop = ns_per_lookup(batches, [&](std::size_t b)
+  {
+    const std::size_t* batch = &indices[(b % POOL) * BATCH];
+    std::uint64_t sum = 0;
+
+    for (std::size_t k = 0; k < BATCH; ++k)
+    {
+      if (auto r = table->at(batch[k]))
+      {
+        sum += r->value.key;
+      }
+    }
+
+    sink = sink + sum;
+  });
+
+  double many = ns_per_lookup(batches, [&](std::size_t b)
+  {
+    const std::size_t* batch = &indices[(b % POOL) * BATCH];
+    std::uint64_t sum = 0;
+    table->at_many(batch, BATCH, out.data());
+
+    for (auto& r : out)
+    {
+      if (r)
+      {
+        sum += r->value.key;
+      }
+    }
+
+    sink = sink + sum;
+  });
+
+  double visit = ns_per_lookup(batches, [&](std::size_t b)
+  {
+    std::uint64_t sum = 0;
+    table->visit_many(&indices[(b % POOL) * BATCH], BATCH, [&](std::size_t, const Row& r)
+    {
+      sum += r.key;
+    });
+
+    sink = sink + sum;
+  });
+
+  std::printf("%zu slots, %zu batches of %zu\n", SLOTS, batches, BATCH);
+  std::printf("at() loop    %6.1f ns/lookup\n", loop);
+  std::printf("at_many      %6.1f ns/lookup  (%.1fx)\n", many, loop / many);
+  std::printf("visit_many   %6.1f ns/lookup  (%.1fx)\n", visit, loop / visit);
+}
@@ -0,0 +1,118 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Scan throughput of Safe_Array::find_if, for_each and size with and without
+// software prefetch, for element sizes from 64 B to 1 KB. Every other slot
+// is erased at random so the scan's branch and access pattern is irregular,
+// as in a long-lived table.
+//
+//   g++ -std=c++17 -O2 -I.. prefetch_scan.cpp -o prefetch_scan
+//   ./prefetch_scan [passes = 5]
+
+#include "safe_array.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+
+template<std::size_t Bytes, bool Prefetch>
+struct Payload
+{
+  std::uint64_t key;
+  unsigned char rest[Bytes - sizeof(std::uint64_t)];
+};
+
+// The baseline: the same element type with prefetching turned off
+template<std::size_t Bytes>
+struct Safe_Prefetch_Distance<Payload<Bytes, false>>
+{
+  static constexpr std::size_t value = 0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+template<typename Func>
+static double best_ms(int passes, Func f)
+{
+  double best = 1e30;
+
+  for (int p = 0; p < passes; ++p)
+  {
+    auto start = Clock::now();
+    f();
+    best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+  }
+
+  return best;
+}
+
+template<std::size_t Bytes, bool Prefetch, std::size_t Slots>
+static void run(int passes, double out[3])
+{
+  using Table = Safe_Array<Payload<Bytes, Prefetch>, Slots>;
+  auto table = std::make_unique<Table>();
+  std::mt19937_64 rng(7);
+
+  for (std::size_t i = 0; i < Slots; ++i)
+  {
+    table->insert(Payload<Bytes, Prefetch>{ i, {} });
+  }
+
+  for (std::size_t i = 0; i < Slots; ++i)
+  {
+    if (rng() & 1)
+    {
+      table->erase(i);
+    }
+  }
+
+  volatile std::uint64_t sink = 0;
+
+  out[0] = best_ms(passes, [&]
+  {
+    auto r = table->find_if([](const Payload<Bytes, Prefetch>& p) { return p.key == ~std::uint64_t(0); });
+    sink = sink + (r ? 1 : 0);
+  });
+
+  out[1] = best_ms(passes, [&]
+  {
+    std::uint64_t sum = 0;
+    table->for_each([&](std::size_t, const Payload<Bytes, Prefetch>& p) { sum += p.key; });
+    sink = sink + sum;
+  });
+
+  out[2] = best_ms(passes, [&]
+  {
+    sink = sink + table->size();
+  });
+}
+
+template<std::size_t Bytes, std::size_t Slots>
+static void compare(int passes)
+{
+  double off[3], on[3];
+  run<Bytes, false, Slots>(passes, off);
+  run<Bytes, true, Slots>(passes, on);
+
+  std::printf("%5zu B  D=%2zu  find_if %7.1f -> %7.1f ms  for_each %7.1f -> %7.1f ms  size %6.1f -> %6.1f ms\n",
+    Bytes, Safe_Prefetch_Distance<Payload<Bytes, true>>::value,
+    off[0], on[0], off[1], on[1], off[2], on[2]);
+}
+
+int main(int argc, char** argv)
+{
+  int passes = argc > 1 ? std::atoi(argv[1]) : 5;
+
+  // About 512 MB per table: far past the last-level cache
+  constexpr std::size_t MB = 512;
+  compare<64, (MB << 20) / 96>(passes);
+  compare<128, (MB << 20) / 160>(passes);
+  compare<256, (MB << 20) / 288>(passes);
+  compare<512, (MB << 20) / 544>(passes);
+  compare<1024, (MB << 20) / 1056>(passes);
+}
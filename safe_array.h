@@ -6,256 +6,2682 @@
 #ifndef LOCKFREE_THREADSAFE_ARRAY
 #define LOCKFREE_THREADSAFE_ARRAY
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <cassert>
 #include <cstdint>
 #include <cstddef>
+#include <memory_resource>
 #include <optional>
+#include <stdexcept>
+#include <thread>
 #include <type_traits>
 #include <new>
 #include <utility>
+#include <vector>
 //#include <iostream>
 
-template<typename T, std::size_t Capacity>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+// Slot state word shared by Safe_Array and the containers built on its
+// storage (see safe_queue.h).
+// Bits 0-1 = state; bits 2-7 = flags; bits 8-15 = owning transaction
+// descriptor (while LOCKED); bits 16-31 = reference count (pinned readers);
+// bits 32-63 = ABA counter (slot generation)
+struct Safe_Slot
+{
+  using Word = std::uint64_t;
+
+  static constexpr Word STATE_MASK = 0x3;
+  static constexpr Word ALIASED = Word(1) << 2;   // Value lives in a shadow slot
+  static constexpr Word REPLACING = Word(1) << 3; // A replace is in flight (holds off retire)
+  static constexpr Word SHADOW = Word(1) << 4;    // INIT slot holding an alias value
+  static constexpr Word LOCKED = Word(1) << 5;    // Held by a transaction (Safe_Mcas)
+  static constexpr Word WATCHED = Word(1) << 6;   // A wait_change() caller is parked here
+  static constexpr Word HOLLOW = Word(1) << 7;    // ALIASED slot whose own value is gone
+  static constexpr Word OWNER_SHIFT = 8;
+  static constexpr Word REF_SHIFT = 16;
+  static constexpr Word REF_ONE = Word(1) << REF_SHIFT;
+  static constexpr Word REF_MAX = 0xFFFF;
+  static constexpr Word REF_MASK = REF_MAX << REF_SHIFT;
+  static constexpr Word COUNTER_SHIFT = 32;
+  static constexpr Word COUNTER_STEP = Word(1) << COUNTER_SHIFT;
+  static constexpr Word COUNTER_MASK = ~(COUNTER_STEP - 1);
+
+  // Matches any generation (real generations never reach all-ones)
+  static constexpr Word ANY_GENERATION = ~Word(0);
+
+  enum SlotState : Word
+  {
+    EMPTY = 0,
+    INIT = 1,
+    READY = 2,
+    REMOVING = 3
+  };
+
+  static constexpr Word state_of(Word st)
+  {
+    return st & STATE_MASK;
+  }
+
+  static constexpr Word counter_of(Word st)
+  {
+    return st & COUNTER_MASK;
+  }
+
+  static constexpr Word refs_of(Word st)
+  {
+    return (st & REF_MASK) >> REF_SHIFT;
+  }
+
+  static constexpr Word generation_of(Word st)
+  {
+    return st >> COUNTER_SHIFT;
+  }
+
+  // Counter advanced by one step, with the given state
+  static constexpr Word bump(Word st, Word state)
+  {
+    return ((st & COUNTER_MASK) + COUNTER_STEP) | state;
+  }
+
+  static constexpr Word make(Word generation, Word state)
+  {
+    return (generation << COUNTER_SHIFT) | state;
+  }
+
+  // Signed distance a - b in the EMPTY -> INIT -> READY -> REMOVING -> EMPTY
+  // cycle, wrapping with the counter. Used to order slots like sequence numbers.
+  static constexpr std::make_signed_t<Word> distance(Word a, Word b)
+  {
+    constexpr Word SHIFT = COUNTER_SHIFT - 2;
+    Word seq_a = ((a >> COUNTER_SHIFT) << 2) | state_of(a);
+    Word seq_b = ((b >> COUNTER_SHIFT) << 2) | state_of(b);
+    return std::make_signed_t<Word>(Word(seq_a - seq_b) << SHIFT) >> SHIFT;
+  }
+};
+
+// Lock-free multi-word CAS over Safe_Slot state words (Harris/Fraser style).
+// A descriptor lists the (word, expected, desired) triples of one
+// transaction. The committer locks each word by swapping in a reference to
+// the descriptor, then decides the outcome with one CAS on its status. A
+// locked word reads as `desired` once the descriptor succeeded and as
+// `expected` otherwise. A thread that needs to write a locked word aborts an
+// undecided descriptor and writes the resolved value back itself, so nobody
+// waits on a preempted committer.
+//
+// Locked word: LOCKED | descriptor << OWNER_SHIFT | round (bits 32-63). The
+// round changes every time a descriptor is reused, so a stale view of a
+// locked word can never be resolved against a later transaction.
+struct Safe_Mcas
+{
+  using Word = Safe_Slot::Word;
+
+  static constexpr std::size_t MAX_WORDS = 8;
+  static constexpr std::size_t POOL_SIZE = 256; // Fits bits 8-15
+
+  enum Outcome : Word
+  {
+    UNDECIDED = 0,
+    SUCCEEDED = 1,
+    FAILED = 2
+  };
+
+  static constexpr Word OUTCOME_MASK = 0x3;
+
+  struct Descriptor
+  {
+    std::atomic<Word> status{ FAILED }; // Round | outcome
+    std::atomic<bool> busy{ false };
+    std::atomic<std::size_t> count{ 0 };
+    std::array<std::atomic<const std::atomic<Word>*>, MAX_WORDS> words{};
+    std::array<std::atomic<Word>, MAX_WORDS> expected{};
+    std::array<std::atomic<Word>, MAX_WORDS> desired{};
+  };
+
+  // Resolution of one locked word
+  struct View
+  {
+    Word expected;
+    Word desired;
+    bool succeeded;
+  };
+
+  static Descriptor& descriptor(std::size_t d)
+  {
+    static std::array<Descriptor, POOL_SIZE> pool{};
+    return pool[d];
+  }
+
+  // Take a free descriptor; spins only if POOL_SIZE commits are in flight
+  static std::size_t acquire()
+  {
+    static std::atomic<std::size_t> hint{ 0 };
+
+    for (std::size_t tries = 1;; ++tries)
+    {
+      std::size_t d = hint.fetch_add(1, std::memory_order_relaxed) % POOL_SIZE;
+
+      if (!descriptor(d).busy.exchange(true, std::memory_order_acquire))
+      {
+        return d;
+      }
+
+      if (tries % POOL_SIZE == 0)
+      {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  // Only call once every word locked by `d` has been written back
+  static void release(std::size_t d)
+  {
+    descriptor(d).busy.store(false, std::memory_order_release);
+  }
+
+  // Start a new round on `d`; returns the round. The status moves on before
+  // the targets are rewritten (release stores), so a stale reader of the
+  // previous round that sees a new target also sees the new round.
+  static Word begin(std::size_t d)
+  {
+    Descriptor& desc = descriptor(d);
+    Word round = Safe_Slot::counter_of(desc.status.load(std::memory_order_relaxed)) +
+      Safe_Slot::COUNTER_STEP;
+
+    desc.status.store(round | UNDECIDED, std::memory_order_relaxed);
+    desc.count.store(0, std::memory_order_release);
+    return round;
+  }
+
+  static void add(std::size_t d, const std::atomic<Word>& word, Word expected, Word desired)
+  {
+    Descriptor& desc = descriptor(d);
+    std::size_t k = desc.count.load(std::memory_order_relaxed);
+
+    desc.words[k].store(&word, std::memory_order_release);
+    desc.expected[k].store(expected, std::memory_order_release);
+    desc.desired[k].store(desired, std::memory_order_release);
+    desc.count.store(k + 1, std::memory_order_release);
+  }
+
+  static Word lock_word(std::size_t d, Word round)
+  {
+    return round | (Word(d) << Safe_Slot::OWNER_SHIFT) | Safe_Slot::LOCKED;
+  }
+
+  static bool undecided(std::size_t d, Word round)
+  {
+    return descriptor(d).status.load(std::memory_order_acquire) == (round | UNDECIDED);
+  }
+
+  // Move `d` from UNDECIDED to `outcome` (no-op if already decided).
+  // Returns true if the round ended SUCCEEDED.
+  static bool decide(std::size_t d, Word round, Outcome outcome)
+  {
+    Word st = round | UNDECIDED;
+    descriptor(d).status.compare_exchange_strong(st, round | outcome,
+      std::memory_order_acq_rel,
+      std::memory_order_acquire);
+
+    return descriptor(d).status.load(std::memory_order_acquire) == (round | SUCCEEDED);
+  }
+
+  // Resolve `w`, a locked value read from `word`; with `abort`, first fail
+  // the owner if it is undecided. Returns false if `w` is stale (the word
+  // was written back meanwhile); reload and retry.
+  static bool inspect(const std::atomic<Word>& word, Word w, bool abort, View& v)
+  {
+    Descriptor& desc = descriptor((w >> Safe_Slot::OWNER_SHIFT) & (POOL_SIZE - 1));
+    Word round = Safe_Slot::counter_of(w);
+    Word st = desc.status.load(std::memory_order_acquire);
+
+    if (abort && st == (round | UNDECIDED) &&
+      desc.status.compare_exchange_strong(st, round | FAILED,
+        std::memory_order_acq_rel,
+        std::memory_order_acquire))
+    {
+      st = round | FAILED;
+    }
+
+    if (Safe_Slot::counter_of(st) != round)
+    {
+      return false;
+    }
+
+    bool found = false;
+    std::size_t n = std::min(desc.count.load(std::memory_order_acquire), MAX_WORDS);
+
+    for (std::size_t k = 0; k < n && !found; ++k)
+    {
+      if (desc.words[k].load(std::memory_order_acquire) == &word)
+      {
+        v.expected = desc.expected[k].load(std::memory_order_acquire);
+        v.desired = desc.desired[k].load(std::memory_order_acquire);
+        found = true;
+      }
+    }
+
+    // The targets are only ours if the round did not move while reading
+    if (!found || Safe_Slot::counter_of(desc.status.load(std::memory_order_acquire)) != round)
+    {
+      return false;
+    }
+
+    v.succeeded = (st & OUTCOME_MASK) == SUCCEEDED;
+    return true;
+  }
+};
+
+// Slot words and free list of the arrays that keep a whole slot in one
+// word, with no INIT phase and no pins (safe_tiny_array.h,
+// safe_column_array.h). Zero-initialized like Safe_Array: free-list links
+// hold index + 1 (0 ends the list), and slots from `untouched` on have
+// never been used.
+//
+// Slot word: bits 0-1 = state (EMPTY / READY); bits 2-31 = generation;
+// bits 32-63 = the owner's payload while READY, the free-list link while
+// EMPTY.
+template<std::size_t Capacity>
+class Safe_Word_Slots
+{
+  static_assert(Capacity > 0 && Capacity < 0xFFFFFFFFULL,
+    "Capacity must fit in 32 bits");
+
+public:
+  using Word = Safe_Slot::Word;
+
+  static constexpr Word GENERATION_SHIFT = 2;
+  static constexpr Word GENERATION_MASK = 0x3FFFFFFFULL;
+  static constexpr Word PAYLOAD_SHIFT = 32;
+  static constexpr std::uint64_t LINK_MASK = 0xFFFFFFFFULL;
+
+  static Word make(Word generation, Word state, Word payload)
+  {
+    return (payload << PAYLOAD_SHIFT) |
+      ((generation & GENERATION_MASK) << GENERATION_SHIFT) | state;
+  }
+
+  static Word generation_of(Word st)
+  {
+    return (st >> GENERATION_SHIFT) & GENERATION_MASK;
+  }
+
+  static Word payload_of(Word st)
+  {
+    return st >> PAYLOAD_SHIFT;
+  }
+
+  std::atomic<Word>& word(std::size_t idx)
+  {
+    return slots[idx];
+  }
+
+  Word load(std::size_t idx) const
+  {
+    return slots[idx].load(std::memory_order_acquire);
+  }
+
+  bool live(std::size_t idx) const
+  {
+    return Safe_Slot::state_of(load(idx)) == Safe_Slot::READY;
+  }
+
+  // Pop a free slot, else the next never-used one; false if none remain.
+  // The slot is the caller's alone until it publishes it.
+  bool claim(std::size_t& index)
+  {
+    std::uint64_t old_head = free_list_head.load(std::memory_order_acquire);
+    std::uint64_t new_head;
+
+    do
+    {
+      std::size_t link = std::size_t(old_head & LINK_MASK);
+
+      if (link == 0)
+      {
+        if (untouched.load(std::memory_order_relaxed) >= Capacity)
+        {
+          return false;
+        }
+
+        index = untouched.fetch_add(1, std::memory_order_relaxed);
+        return index < Capacity;
+      }
+
+      index = link - 1;
+      Word next = payload_of(slots[index].load(std::memory_order_acquire));
+      new_head = (((old_head >> 32) + 1) << 32) | (next & LINK_MASK);
+    } while (!free_list_head.compare_exchange_weak(
+      old_head, new_head,
+      std::memory_order_acquire,
+      std::memory_order_acquire));
+
+    return true;
+  }
+
+  // Publish a claimed slot READY at its next generation, with `payload`.
+  // Returns the published word.
+  Word publish(std::size_t idx, Word payload)
+  {
+    Word st = make(generation_of(slots[idx].load(std::memory_order_relaxed)) + 1,
+      Safe_Slot::READY, payload);
+    slots[idx].store(st, std::memory_order_release);
+    return st;
+  }
+
+  // Empty a READY slot (of `generation`, if given) with one CAS and free
+  // it. Returns true if it was live.
+  bool erase(std::size_t idx, Word generation = Safe_Slot::ANY_GENERATION)
+  {
+    if (idx >= Capacity)
+    {
+      return false;
+    }
+
+    Word st = slots[idx].load(std::memory_order_acquire);
+    Word empty;
+
+    do
+    {
+      if (Safe_Slot::state_of(st) != Safe_Slot::READY ||
+        (generation != Safe_Slot::ANY_GENERATION && generation_of(st) != generation))
+      {
+        return false;
+      }
+
+      empty = make(generation_of(st) + 1, Safe_Slot::EMPTY, 0);
+    } while (!slots[idx].compare_exchange_weak(
+      st, empty,
+      std::memory_order_acq_rel,
+      std::memory_order_acquire));
+
+    push_free_index(idx, generation_of(empty));
+    return true;
+  }
+
+  Word generation(std::size_t idx) const
+  {
+    if (idx >= Capacity)
+    {
+      return Safe_Slot::ANY_GENERATION;
+    }
+
+    return generation_of(load(idx));
+  }
+
+  // Slots [0, touched()) may hold elements
+  std::size_t touched() const
+  {
+    return std::min(untouched.load(std::memory_order_acquire), Capacity);
+  }
+
+  // Count live slots (O(slots ever used))
+  std::size_t size() const
+  {
+    std::size_t cnt = 0;
+
+    for (std::size_t i = 0, end = touched(); i < end; ++i)
+    {
+      if (live(i))
+      {
+        ++cnt;
+      }
+    }
+
+    return cnt;
+  }
+
+  constexpr Safe_Word_Slots()
+  {
+  }
+
+private:
+  std::array<std::atomic<Word>, Capacity> slots{};
+  std::atomic<std::uint64_t> free_list_head{ 0 }; // Link | ABA counter << 32
+  std::atomic<std::size_t> untouched{ 0 };
+
+  // Link EMPTY slot `index` (now at `generation`) into the free list; the
+  // link rides in the slot's payload bits
+  void push_free_index(std::size_t index, Word generation)
+  {
+    std::uint64_t old_head = free_list_head.load(std::memory_order_relaxed);
+    std::uint64_t new_head;
+
+    do
+    {
+      slots[index].store(make(generation, Safe_Slot::EMPTY, old_head & LINK_MASK),
+        std::memory_order_relaxed);
+      new_head = (((old_head >> 32) + 1) << 32) | std::uint64_t(index + 1);
+    } while (!free_list_head.compare_exchange_weak(
+      old_head, new_head,
+      std::memory_order_release,
+      std::memory_order_relaxed));
+  }
+};
+
+// True if `const T& == const K&` is valid: find() then compares against a
+// K directly instead of building a temporary T
+template<typename T, typename K, typename = void>
+struct Safe_Equality_Comparable : std::false_type
+{
+};
+
+template<typename T, typename K>
+struct Safe_Equality_Comparable<T, K,
+  std::void_t<decltype(std::declval<const T&>() == std::declval<const K&>())>> : std::true_type
+{
+};
+
+// Kinds of change a Safe_Array reports to its Feed
+enum class Safe_Change_Op : std::uint8_t
+{
+  INSERT,
+  ERASE,
+  REPLACE
+};
+
+// Default Feed: change reporting compiled out. A Feed is told about every
+// insert, erase and replace (including committed transaction steps) right
+// after it becomes visible, with the slot generation it produced (for an
+// erase, the generation of the element erased). See safe_change_feed.h.
+struct Safe_No_Feed
+{
+  static constexpr std::size_t MAX_SLOTS = ~std::size_t(0);
+
+  void publish(Safe_Change_Op, std::size_t, Safe_Slot::Word)
+  {
+  }
+};
+
+// A Feed may also define claimed(index) and freed(index): claimed runs when
+// an insert has built its element, before it becomes visible, and freed
+// when the slot goes back to the free list. Unlike publish() the two are
+// ordered per slot, as the slot is owned in between (see safe_occupancy.h).
+template<typename Feed, typename = void>
+struct Safe_Slot_Tracking_Feed : std::false_type
+{
+};
+
+template<typename Feed>
+struct Safe_Slot_Tracking_Feed<Feed,
+  std::void_t<decltype(std::declval<Feed&>().claimed(std::size_t())),
+    decltype(std::declval<Feed&>().freed(std::size_t()))>> : std::true_type
+{
+};
+
+// Told a Safe_Array's approximate size as it moves (see Safe_Array::watch
+// and safe_watermarks.h). update() runs on whichever thread wrote last,
+// possibly on several at once.
+struct Safe_Size_Watcher
+{
+  virtual void update(std::size_t live) = 0;
+
+protected:
+  ~Safe_Size_Watcher() = default;
+};
+
+// Who may write a Safe_Array. Readers (at, acquire, find_if, for_each,
+// wait_change, ...) may always run on any thread.
+//   MULTI_WRITER:  any number of threads insert/erase/replace/commit
+//   SINGLE_WRITER: one thread at a time writes; the free list becomes a
+//                  plain list and insert/erase drop their CAS loops.
+//                  Debug builds assert on overlapping writers.
+//   NONE:          the array is confined to one thread at a time (readers
+//                  included); every read-modify-write of the state words and
+//                  free list becomes a plain load and store.
+enum class Safe_Concurrency : std::uint8_t
+{
+  MULTI_WRITER,
+  SINGLE_WRITER,
+  NONE
+};
+
+// How many slots ahead Safe_Array scans (find_if, acquire_if, size,
+// for_each) prefetch. The default looks about 16 KB ahead (an entry is T
+// plus some 32 bytes of slot bookkeeping), between 8 and 32 slots; specialize
+// for a T to tune it, or set 0 to turn prefetching off.
+template<typename T>
+struct Safe_Prefetch_Distance
+{
+  static constexpr std::size_t value =
+    std::clamp<std::size_t>(16384 / (sizeof(T) + 32), 8, 32);
+};
+
+// Capacity of a Safe_Array sized at run time: the entry block is allocated
+// from a std::pmr::memory_resource passed to the constructor
+inline constexpr std::size_t Safe_Dynamic_Capacity = ~std::size_t(0);
+
+// Also implemented by memory resources that can build the objects of a
+// block in their own pass over it (see safe_huge_pages.h). A
+// Safe_Dynamic_Capacity array allocates its entry block through it, so the
+// entries are constructed as the resource first touches the block, split
+// over its threads, instead of in a serial pass that faults in the whole
+// block on one thread.
+class Safe_Constructing_Resource
+{
+public:
+  // Allocate `count` objects of `size` bytes aligned to `alignment`, and
+  // call construct(first, n) over runs covering all of them before
+  // returning (possibly from several threads at once). Freed with the
+  // memory_resource's deallocate(p, count * size, alignment).
+  virtual void* allocate_constructed(std::size_t count, std::size_t size,
+    std::size_t alignment, void (*construct)(void* first, std::size_t n)) = 0;
+
+protected:
+  ~Safe_Constructing_Resource() = default;
+};
+
+template<typename T, std::size_t Capacity, typename Feed = Safe_No_Feed,
+  Safe_Concurrency Concurrency = Safe_Concurrency::MULTI_WRITER>
 class Safe_Array
 {
   static_assert(std::is_nothrow_destructible<T>::value,
     "T must be nothrow destructible");
+  static_assert(Capacity == Safe_Dynamic_Capacity || Capacity <= Feed::MAX_SLOTS,
+    "Capacity exceeds what the change feed can index");
+
+  static constexpr bool DYNAMIC = Capacity == Safe_Dynamic_Capacity;
+
+private:
+  struct Entry : Safe_Slot
+  {
+    std::atomic<Word> state{ EMPTY };
+
+    // Raw storage for one T: a union whose trivial member is the one
+    // initialized, so a constexpr constructor can leave the T unbuilt
+    union Storage
+    {
+      unsigned char none;
+      T value;
+
+      constexpr Storage()
+        : none()
+      {
+      }
+
+      ~Storage()
+      {
+      }
+    } storage;
+
+    std::atomic<std::size_t> next_free_index{ 0 }; // Link: index + 1, 0 ends the list
+  };
+
+  // Entry block of a Safe_Dynamic_Capacity array, owned by `resource`
+  struct Dynamic_Block
+  {
+    Entry* entries = nullptr;
+    std::size_t count = 0;
+    std::pmr::memory_resource* resource = nullptr;
+
+    Entry& operator[](std::size_t i)
+    {
+      return entries[i];
+    }
+
+    const Entry& operator[](std::size_t i) const
+    {
+      return entries[i];
+    }
+  };
+
+  // Construct the `n` entries of a fresh block starting at `first`
+  static void construct_entries(void* first, std::size_t n)
+  {
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      ::new (static_cast<void*>(static_cast<unsigned char*>(first) + i * sizeof(Entry))) Entry();
+    }
+  }
+
+  // Everything starts zeroed, so a static array is constant-initialized
+  // into .bss: free-list links hold index + 1 (0 ends a list), and slots
+  // from `untouched` on have never been used and are handed out in order
+  // once the free list runs dry
+  std::conditional_t<DYNAMIC, Dynamic_Block, std::array<Entry, DYNAMIC ? 1 : Capacity>> data;
+  std::atomic<std::uint64_t> free_list_head{ 0 };
+  std::atomic<std::size_t> untouched{ 0 };
+  static constexpr std::size_t INVALID_INDEX = Capacity;
+  Feed feed{};
+
+  // Shadow slots published by replace(), a pair per slot, one per
+  // generation parity (low/high 32 bits); only meaningful while the slot is
+  // ALIASED. Allocated by the first replace, so arrays that never replace
+  // carry no alias words.
+  std::atomic<std::atomic<std::uint64_t>*> aliases{ nullptr };
+
+  // SINGLE_WRITER: free_list_head is the writer's own list; slots freed on
+  // other threads (the last Guard out, a reader settling a commit) are
+  // pushed here and taken over in one exchange when that list runs dry
+  std::atomic<std::size_t> returned_head{ 0 };
+
+  // Live-element count for approx_size(), split into cache-line shards
+  // picked per thread, so writers on different threads rarely share a line.
+  // Each shard is a wrapping sum of +1 per insert and -1 per erase.
+  struct alignas(64) Size_Shard
+  {
+    std::atomic<Safe_Slot::Word> delta{ 0 };
+  };
+
+  // NONE is a single writer too; it just has no readers on other threads
+  static constexpr bool SINGLE_WRITER = Concurrency != Safe_Concurrency::MULTI_WRITER;
+  static constexpr bool UNSYNCHRONIZED = Concurrency == Safe_Concurrency::NONE;
+
+  // One writer needs no sharding (commits it started may still be counted
+  // by a reader that settles them, so the shard stays atomic)
+  static constexpr std::size_t SIZE_SHARDS = SINGLE_WRITER ? 1 : 16;
+  std::array<Size_Shard, SIZE_SHARDS> size_shards{};
+
+  // Set by watch(); a shard reports every watch_stride() net changes
+  std::atomic<Safe_Size_Watcher*> watcher{ nullptr };
+
+#ifndef NDEBUG
+  std::atomic<bool> writing{ false };
+#endif
+
+  // Held by every write on a SINGLE_WRITER or NONE array; in debug builds,
+  // asserts that no other thread is writing at the same time
+  class Write_Scope
+  {
+#ifndef NDEBUG
+    std::atomic<bool>* flag = nullptr;
+#endif
+
+  public:
+    explicit Write_Scope(Safe_Array& owner)
+    {
+#ifndef NDEBUG
+      if constexpr (SINGLE_WRITER)
+      {
+        bool overlapping = owner.writing.exchange(true, std::memory_order_acquire);
+        assert(!overlapping && "second writer on a single-writer Safe_Array");
+        flag = overlapping ? nullptr : &owner.writing;
+      }
+#endif
+      (void)owner;
+    }
+
+    Write_Scope(const Write_Scope&) = delete;
+    Write_Scope& operator=(const Write_Scope&) = delete;
+
+    ~Write_Scope()
+    {
+#ifndef NDEBUG
+      if (flag)
+      {
+        flag->store(false, std::memory_order_release);
+      }
+#endif
+    }
+  };
+
+  static constexpr std::size_t PREFETCH_DISTANCE = Safe_Prefetch_Distance<T>::value;
+
+  static void prefetch(const void* p)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(p, 0, 3);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#else
+    (void)p;
+#endif
+  }
+
+  // Scans call this for slot i: it requests slot i + PREFETCH_DISTANCE, the
+  // state word and (for scans that read values) the payload separately.
+  // Large entries straddle lines at every stride, so the payload request
+  // targets the end of its first 64 bytes, where a predicate usually looks.
+  template<bool Payload>
+  void prefetch_ahead(std::size_t i, std::size_t end) const
+  {
+    if constexpr (PREFETCH_DISTANCE > 0)
+    {
+      std::size_t j = i + PREFETCH_DISTANCE;
+
+      if (j < end)
+      {
+        prefetch_slot<Payload>(j);
+      }
+    }
+  }
+
+  template<bool Payload>
+  void prefetch_slot(std::size_t idx) const
+  {
+    prefetch(&data[idx].state);
+
+    if constexpr (Payload)
+    {
+      constexpr std::size_t HEAD = sizeof(T) < 64 ? sizeof(T) : 64;
+      prefetch(reinterpret_cast<const unsigned char*>(&data[idx].storage) + HEAD - 1);
+    }
+  }
+
+  // Lookups at_many/visit_many keep in flight: each resolves one index
+  // while the slots of the next BATCH_WINDOW are being fetched
+  static constexpr std::size_t BATCH_WINDOW = 16;
+
+  // Draws sample() makes before giving up on a churning array
+  static constexpr int SAMPLE_ATTEMPTS = 64;
+
+  template<typename Func>
+  void batch(const std::size_t* indices, std::size_t count, Func resolve) const
+  {
+    std::size_t n = slot_count();
+
+    for (std::size_t k = 0; k < count && k < BATCH_WINDOW; ++k)
+    {
+      if (indices[k] < n)
+      {
+        prefetch_slot<true>(indices[k]);
+      }
+    }
+
+    for (std::size_t k = 0; k < count; ++k)
+    {
+      if (k + BATCH_WINDOW < count && indices[k + BATCH_WINDOW] < n)
+      {
+        prefetch_slot<true>(indices[k + BATCH_WINDOW]);
+      }
+
+      resolve(k, at(indices[k]));
+    }
+  }
+
+  // Number of slots: Capacity, or the size given at construction
+  constexpr std::size_t slot_count() const
+  {
+    if constexpr (DYNAMIC)
+    {
+      return data.count;
+    }
+    else
+    {
+      return Capacity;
+    }
+  }
+
+  std::uint64_t pack_index_counter(std::size_t idx, std::size_t ctr) const
+  {
+    return (std::uint64_t(ctr) << 32) | idx;
+  }
+
+  void unpack_index_counter(std::uint64_t v, std::size_t& idx, std::size_t& ctr) const
+  {
+    idx = std::size_t(v & 0xFFFFFFFFULL);
+    ctr = std::size_t(v >> 32);
+  }
+
+  // Read-modify-writes on the state words. Under NONE nothing else can
+  // touch the word in between, so they become a plain load and store.
+  static bool compare_exchange(std::atomic<Safe_Slot::Word>& word,
+    Safe_Slot::Word& expected, Safe_Slot::Word desired,
+    std::memory_order success, std::memory_order failure)
+  {
+    if constexpr (UNSYNCHRONIZED)
+    {
+      Safe_Slot::Word cur = word.load(std::memory_order_relaxed);
+
+      if (cur != expected)
+      {
+        expected = cur;
+        return false;
+      }
+
+      word.store(desired, std::memory_order_relaxed);
+      return true;
+    }
+
+    return word.compare_exchange_weak(expected, desired, success, failure);
+  }
+
+  // Returns the previous value
+  static Safe_Slot::Word fetch_add(std::atomic<Safe_Slot::Word>& word,
+    Safe_Slot::Word delta, std::memory_order order)
+  {
+    if constexpr (UNSYNCHRONIZED)
+    {
+      Safe_Slot::Word cur = word.load(std::memory_order_relaxed);
+      word.store(cur + delta, std::memory_order_relaxed);
+      return cur;
+    }
+
+    return word.fetch_add(delta, order);
+  }
+
+  static std::size_t size_shard()
+  {
+    if constexpr (SIZE_SHARDS == 1)
+    {
+      return 0;
+    }
+    else
+    {
+      thread_local const std::size_t shard =
+        std::hash<std::thread::id>()(std::this_thread::get_id()) % SIZE_SHARDS;
+      return shard;
+    }
+  }
+
+  // Power of two near slot_count() / (64 * SIZE_SHARDS): a watcher then
+  // hears of every move of about 1/64 of the capacity, while most writes
+  // skip the shard sum
+  std::size_t watch_stride() const
+  {
+    std::size_t target = slot_count() / (64 * SIZE_SHARDS);
+    std::size_t stride = 1;
+
+    while (stride * 2 <= target)
+    {
+      stride *= 2;
+    }
+
+    return stride;
+  }
+
+  // Report a change to the size counters, the watcher and the Feed
+  void publish(Safe_Change_Op op, std::size_t idx, Safe_Slot::Word generation)
+  {
+    if (op != Safe_Change_Op::REPLACE)
+    {
+      Safe_Slot::Word delta = op == Safe_Change_Op::INSERT ? 1 : ~Safe_Slot::Word(0);
+      Safe_Slot::Word now =
+        fetch_add(size_shards[size_shard()].delta, delta, std::memory_order_relaxed) + delta;
+
+      if (Safe_Size_Watcher* w = watcher.load(std::memory_order_acquire))
+      {
+        if ((now & (watch_stride() - 1)) == 0)
+        {
+          w->update(approx_size());
+        }
+      }
+    }
+
+    feed.publish(op, idx, generation);
+  }
+
+  // A slot was claimed by an insert / is going back to the free list
+  void feed_claimed(std::size_t idx)
+  {
+    if constexpr (Safe_Slot_Tracking_Feed<Feed>::value)
+    {
+      feed.claimed(idx);
+    }
+  }
+
+  void feed_freed(std::size_t idx)
+  {
+    if constexpr (Safe_Slot_Tracking_Feed<Feed>::value)
+    {
+      feed.freed(idx);
+    }
+  }
+
+  // Push a freed slot back onto the lock-free free-list
+  void push_free_index(std::size_t index)
+  {
+    if constexpr (UNSYNCHRONIZED)
+    {
+      push_local_index(index);
+      return;
+    }
+    else if constexpr (SINGLE_WRITER)
+    {
+      // Any thread may free a slot; only the writer takes them back out,
+      // all at once, so a plain Treiber push needs no ABA counter
+      std::size_t head = returned_head.load(std::memory_order_relaxed);
+
+      do
+      {
+        data[index].next_free_index.store(head, std::memory_order_relaxed);
+      } while (!returned_head.compare_exchange_weak(
+        head, index + 1,
+        std::memory_order_release,
+        std::memory_order_relaxed));
+
+      return;
+    }
+
+    std::uint64_t old_head = free_list_head.load(std::memory_order_relaxed);
+    std::uint64_t new_head;
+    std::size_t old_idx, old_ctr;
+
+    do
+    {
+      unpack_index_counter(old_head, old_idx, old_ctr);
+      data[index].next_free_index.store(old_idx, std::memory_order_relaxed);
+      new_head = pack_index_counter(index + 1, old_ctr + 1);
+    } while (!free_list_head.compare_exchange_weak(
+      old_head, new_head,
+      std::memory_order_release,
+      std::memory_order_relaxed));
+  }
+
+  // SINGLE_WRITER: give a slot the writer freed itself back to its own list
+  void push_local_index(std::size_t index)
+  {
+    data[index].next_free_index.store(
+      std::size_t(free_list_head.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+    free_list_head.store(index + 1, std::memory_order_relaxed);
+  }
+
+  // Hand out the next never-used slot; false once all have been
+  bool pop_untouched_index(std::size_t& index)
+  {
+    if constexpr (SINGLE_WRITER)
+    {
+      index = untouched.load(std::memory_order_relaxed);
+
+      if (index == slot_count())
+      {
+        return false;
+      }
+
+      untouched.store(index + 1, std::memory_order_relaxed);
+      return true;
+    }
+
+    // Checked first so the counter stops at the slot count, bar racing losers
+    if (untouched.load(std::memory_order_relaxed) >= slot_count())
+    {
+      return false;
+    }
+
+    index = untouched.fetch_add(1, std::memory_order_relaxed);
+    return index < slot_count();
+  }
+
+  // Pop a free slot; returns false if none remain
+  bool pop_free_index(std::size_t& index)
+  {
+    if constexpr (SINGLE_WRITER)
+    {
+      std::size_t head = std::size_t(free_list_head.load(std::memory_order_relaxed));
+
+      if (head == 0 && !UNSYNCHRONIZED)
+      {
+        head = returned_head.exchange(0, std::memory_order_acquire);
+      }
+
+      if (head == 0)
+      {
+        return pop_untouched_index(index);
+      }
+
+      index = head - 1;
+      free_list_head.store(
+        data[index].next_free_index.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      return true;
+    }
+
+    std::uint64_t old_head = free_list_head.load(std::memory_order_relaxed);
+    std::uint64_t new_head;
+    std::size_t old_idx, old_ctr;
+
+    do
+    {
+      unpack_index_counter(old_head, old_idx, old_ctr);
+
+      if (old_idx == 0)
+      {
+        return pop_untouched_index(index);
+      }
+
+      index = old_idx - 1;
+      std::size_t next_idx = data[index].next_free_index.load(std::memory_order_relaxed);
+
+      new_head = pack_index_counter(next_idx, old_ctr + 1);
+    } while (!free_list_head.compare_exchange_weak(
+      old_head, new_head,
+      std::memory_order_acquire,
+      std::memory_order_relaxed));
+
+    return true;
+  }
+
+  // Wake wait_change() callers parked on `idx` if `prev`, the word just
+  // overwritten, carried WATCHED. Unwatched slots skip the syscall.
+  void notify(std::size_t idx, Safe_Slot::Word prev)
+  {
+#if defined(__cpp_lib_atomic_wait)
+    if (prev & Safe_Slot::WATCHED)
+    {
+      data[idx].state.notify_all();
+    }
+#else
+    (void)idx;
+    (void)prev;
+#endif
+  }
+
+  // Publish REMOVING slot `idx`, last seen as `rem_st`, EMPTY for its next
+  // generation. Nothing but a wait_change() arming WATCHED can touch the
+  // word meanwhile, so it is swapped rather than CASed, and the waiter is
+  // woken from the word actually overwritten.
+  void publish_empty(std::size_t idx, Safe_Slot::Word rem_st)
+  {
+    Safe_Slot::Word empty_st = Entry::bump(rem_st, Entry::EMPTY);
+
+    if constexpr (UNSYNCHRONIZED)
+    {
+      data[idx].state.store(empty_st, std::memory_order_release);
+    }
+    else
+    {
+      notify(idx, data[idx].state.exchange(empty_st, std::memory_order_acq_rel));
+    }
+  }
+
+  // Destroy the element of a REMOVING slot nobody pins any more, publish
+  // it EMPTY and return it to the free list
+  void retire(std::size_t idx, Safe_Slot::Word rem_st, bool destroy = true)
+  {
+    Entry& e = data[idx];
+
+    // 1) Destroy in-place (an ALIASED slot's own value may already be gone)
+    if (destroy)
+    {
+      reinterpret_cast<T*>(&e.storage)->~T();
+    }
+
+    // 2) Bump counter, mark EMPTY (a waiter may have set WATCHED meanwhile)
+    publish_empty(idx, rem_st);
+
+    // 3) Return slot to free list
+    feed_freed(idx);
+    push_free_index(idx);
+  }
+
+  // Drop one pin; the last pin out of a REMOVING slot retires it (unless a
+  // replace still claims it; see unclaim)
+  void release(std::size_t idx)
+  {
+    Entry& e = data[idx];
+    Safe_Slot::Word prev = e.state.load(std::memory_order_acquire); // Others' reads happen first
+    bool destroyed = false;
+
+    for (;;)
+    {
+      // Last pin on a replaced slot's own value (nothing pins that again):
+      // destroy it before letting go, so an erase cannot free the slot
+      // under the destructor, and leave the storage HOLLOW for fold()
+      if (Entry::refs_of(prev) == 1 && Entry::state_of(prev) == Entry::READY &&
+        (prev & Entry::ALIASED))
+      {
+        reinterpret_cast<T*>(&e.storage)->~T();
+        destroyed = true;
+        prev = fetch_add(e.state, Entry::HOLLOW - Safe_Slot::REF_ONE, std::memory_order_acq_rel);
+        break;
+      }
+
+      if (compare_exchange(e.state,
+        prev, prev - Safe_Slot::REF_ONE,
+        std::memory_order_acq_rel,
+        std::memory_order_acquire))
+      {
+        break;
+      }
+    }
+
+    if (Entry::refs_of(prev) != 1)
+    {
+      return;
+    }
+
+    if (Entry::state_of(prev) == Entry::REMOVING)
+    {
+      if (prev & Entry::REPLACING)
+      {
+        return;
+      }
+
+      retire(idx, prev - Safe_Slot::REF_ONE, !destroyed);
+    }
+    else if (destroyed)
+    {
+      try_fold(idx);
+    }
+  }
+
+  // Add a pin to slot `idx` if (state & mask) == expect. Returns false if it
+  // does not match, or REF_MAX pins are already held.
+  bool pin(std::size_t idx, Safe_Slot::Word mask, Safe_Slot::Word expect)
+  {
+    auto& state = data[idx].state;
+    Safe_Slot::Word st = state.load(std::memory_order_acquire);
+
+    do
+    {
+      if (st & Safe_Slot::LOCKED)
+      {
+        st = settle(idx); // Transactions only lock unpinned slots
+      }
+
+      if ((st & mask) != expect || Entry::refs_of(st) == Safe_Slot::REF_MAX)
+      {
+        return false;
+      }
+    } while (!compare_exchange(state,
+      st, st + Safe_Slot::REF_ONE,
+      std::memory_order_acq_rel,
+      std::memory_order_acquire));
+
+    return true;
+  }
+
+  // Shadow slot holding the value published by ALIASED state `st` of `idx`
+  std::size_t alias_of(std::size_t idx, Safe_Slot::Word st) const
+  {
+    std::uint64_t pair = aliases.load(std::memory_order_acquire)[idx].load(std::memory_order_acquire);
+    return std::size_t((Entry::generation_of(st) & 1) ? pair >> 32 : pair & 0xFFFFFFFFULL);
+  }
+
+  // The alias words, allocated on first use (before a replace claims its
+  // slot, so a failed allocation leaves nothing half done)
+  std::atomic<std::uint64_t>* alias_words()
+  {
+    std::atomic<std::uint64_t>* words = aliases.load(std::memory_order_acquire);
+
+    if (!words)
+    {
+      auto* fresh = new std::atomic<std::uint64_t>[slot_count()]();
+
+      if (aliases.compare_exchange_strong(words, fresh,
+        std::memory_order_acq_rel,
+        std::memory_order_acquire))
+      {
+        return fresh;
+      }
+
+      delete[] fresh;
+    }
+
+    return words;
+  }
+
+  // True if the slot still shows the state, generation and aliasing of `st`
+  // (a fold moves the value home without a new generation)
+  bool unchanged(std::size_t idx, Safe_Slot::Word st) const
+  {
+    constexpr Safe_Slot::Word MASK =
+      Safe_Slot::COUNTER_MASK | Safe_Slot::STATE_MASK | Safe_Slot::ALIASED;
+    return (load_state(idx) & MASK) == (st & MASK);
+  }
+
+  // Generation wait_change() reports for state `st`: a REMOVING slot is
+  // already past its element, and shows the generation it is freed into
+  static Safe_Slot::Word shown_generation(Safe_Slot::Word st)
+  {
+    return Entry::generation_of(st) + (Entry::state_of(st) == Entry::REMOVING ? 1 : 0);
+  }
+
+  // Slot whose storage holds the value published by `st` at `idx`, or
+  // INVALID_INDEX if the slot moved on while following the alias
+  std::size_t physical(std::size_t idx, Safe_Slot::Word st) const
+  {
+    if (!(st & Safe_Slot::ALIASED))
+    {
+      return idx;
+    }
+
+    std::size_t p = alias_of(idx, st);
+    return unchanged(idx, st) ? p : INVALID_INDEX;
+  }
+
+  T* value_ptr(std::size_t physical_idx) const
+  {
+    return const_cast<T*>(reinterpret_cast<T const*>(&data[physical_idx].storage));
+  }
+
+  // Take a published shadow slot out of service; destroyed when unpinned
+  void unpublish_shadow(std::size_t idx)
+  {
+    Entry& e = data[idx];
+    Safe_Slot::Word st = e.state.load(std::memory_order_relaxed);
+    Safe_Slot::Word rem_st;
+
+    do
+    {
+      rem_st = (st & ~(Entry::STATE_MASK | Entry::WATCHED)) | Entry::REMOVING;
+    } while (!compare_exchange(e.state,
+      st, rem_st,
+      std::memory_order_acq_rel,
+      std::memory_order_relaxed));
+
+    notify(idx, st);
+
+    if (Entry::refs_of(rem_st) == 0)
+    {
+      retire(idx, rem_st);
+    }
+  }
+
+  // Pop a free slot and construct T(args...) in it, leaving it INIT
+  // (invisible to readers). Returns false if full/raced.
+  template<typename... Args>
+  bool build(std::size_t& idx, Safe_Slot::Word& init_st, Args&&... args)
+  {
+    if (!pop_free_index(idx))
+    {
+      return false;
+    }
+
+    Entry& e = data[idx];
+
+    if constexpr (SINGLE_WRITER)
+    {
+      // Nobody else moves a free slot's state; a waiter may still set
+      // WATCHED, which the add keeps
+      init_st = fetch_add(e.state, Entry::INIT, std::memory_order_acq_rel) + Entry::INIT;
+      ::new (value_ptr(idx)) T(std::forward<Args>(args)...);
+      return true;
+    }
+
+    // CAS EMPTY -> INIT (capture current ABA counter; a parked waiter's
+    // WATCHED rides along until the slot is published)
+    Safe_Slot::Word old_st = e.state.load(std::memory_order_relaxed);
+
+    do
+    {
+      if (Entry::state_of(old_st) != Entry::EMPTY)
+      {
+        return false; // Racing fail
+      }
+
+      init_st = Entry::counter_of(old_st) | (old_st & Entry::WATCHED) | Entry::INIT;
+    } while (!compare_exchange(e.state,
+      old_st, init_st,
+      std::memory_order_acq_rel,
+      std::memory_order_relaxed));
+
+    ::new (value_ptr(idx)) T(std::forward<Args>(args)...);
+    return true;
+  }
+
+  // Record shadow slot `shadow` for the generation after `st`; readers of
+  // the current generation still use the other half
+  void publish_alias(std::size_t idx, Safe_Slot::Word st, std::size_t shadow)
+  {
+    std::atomic<std::uint64_t>& alias = alias_words()[idx];
+    std::uint64_t pair = alias.load(std::memory_order_relaxed);
+    std::uint64_t next_gen = Entry::generation_of(st) + 1;
+    pair = (next_gen & 1)
+      ? (pair & 0xFFFFFFFFULL) | (std::uint64_t(shadow) << 32)
+      : (pair & ~0xFFFFFFFFULL) | std::uint64_t(shadow);
+    alias.store(pair, std::memory_order_release);
+  }
+
+  // Drop the REPLACING claim taken on `idx` at state `st`. The claim keeps
+  // an erased slot from being retired (and reused, which would let our
+  // alias write clobber a later generation), so if the slot was erased
+  // meanwhile and nobody pins it, retire it here. A replaced slot whose
+  // own storage is free again is folded first. Returns true if it was.
+  bool unclaim(std::size_t idx, Safe_Slot::Word st)
+  {
+    auto& state = data[idx].state;
+    Safe_Slot::Word cur = state.load(std::memory_order_acquire);
+    Safe_Slot::Word next;
+    bool tried = false;
+    bool folded = false;
+
+    do
+    {
+      if (cur & Safe_Slot::LOCKED)
+      {
+        cur = settle(idx);
+      }
+
+      if (!(cur & Entry::REPLACING) || Entry::counter_of(cur) != Entry::counter_of(st))
+      {
+        return folded;
+      }
+
+      if (!tried && Entry::state_of(cur) == Entry::READY &&
+        (cur & (Entry::ALIASED | Entry::HOLLOW)) == (Entry::ALIASED | Entry::HOLLOW))
+      {
+        tried = true;
+        folded = fold(idx, cur);
+      }
+
+      next = cur & ~Entry::REPLACING;
+    } while (!compare_exchange(state,
+      cur, next,
+      std::memory_order_acq_rel,
+      std::memory_order_acquire));
+
+    if (Entry::state_of(next) == Entry::REMOVING && Entry::refs_of(next) == 0)
+    {
+      retire(idx, next, !(next & Entry::ALIASED));
+    }
+
+    return folded;
+  }
+
+  // Copy the value of replaced slot `idx` (state `cur`, claimed REPLACING
+  // by the caller) back into the slot's own storage, which is free again
+  // (HOLLOW), and unpublish the shadow slot it lived in: a replace holds
+  // a second slot only until the old value's readers drain. Readers
+  // pinning the shadow keep it until released. The generation is kept;
+  // readers that followed the alias notice ALIASED gone (see unchanged).
+  // Returns false, with `cur` reloaded, if the slot was erased meanwhile
+  // (or T cannot be copied, in which case the shadow stays until erased).
+  bool fold(std::size_t idx, Safe_Slot::Word& cur)
+  {
+    if constexpr (!std::is_copy_constructible<T>::value)
+    {
+      (void)idx;
+      (void)cur;
+      return false;
+    }
+    else
+    {
+      auto& state = data[idx].state;
+      std::size_t shadow = alias_of(idx, cur);
+
+      // Pinned, so an erase meanwhile cannot destroy it under the copy
+      if (!pin(shadow, Entry::STATE_MASK | Entry::SHADOW, Entry::INIT | Entry::SHADOW))
+      {
+        cur = state.load(std::memory_order_acquire);
+        return false;
+      }
+
+      if (!unchanged(idx, cur))
+      {
+        release(shadow);
+        cur = state.load(std::memory_order_acquire);
+        return false;
+      }
+
+      ::new (value_ptr(idx)) T(static_cast<const T&>(*value_ptr(shadow)));
+      Safe_Slot::Word next;
+
+      do
+      {
+        if (cur & Safe_Slot::LOCKED)
+        {
+          cur = settle(idx);
+        }
+
+        if (Entry::state_of(cur) != Entry::READY || !(cur & Entry::ALIASED))
+        {
+          // Erased meanwhile, which also unpublished the shadow
+          reinterpret_cast<T*>(&data[idx].storage)->~T();
+          release(shadow);
+          return false;
+        }
+
+        next = cur & ~(Entry::ALIASED | Entry::HOLLOW);
+      } while (!compare_exchange(state,
+        cur, next,
+        std::memory_order_acq_rel,
+        std::memory_order_acquire));
+
+      cur = next;
+      unpublish_shadow(shadow);
+      release(shadow);
+      return true;
+    }
+  }
+
+  // Fold `idx` once its old value's last pin is gone, unless a replace
+  // holding the claim is about to (see unclaim)
+  void try_fold(std::size_t idx)
+  {
+    auto& state = data[idx].state;
+    Safe_Slot::Word cur = state.load(std::memory_order_acquire);
+
+    do
+    {
+      if (cur & Safe_Slot::LOCKED)
+      {
+        cur = settle(idx);
+      }
+
+      if (Entry::state_of(cur) != Entry::READY ||
+        (cur & (Entry::ALIASED | Entry::HOLLOW | Entry::REPLACING)) !=
+          (Entry::ALIASED | Entry::HOLLOW))
+      {
+        return;
+      }
+    } while (!compare_exchange(state,
+      cur, cur | Entry::REPLACING,
+      std::memory_order_acq_rel,
+      std::memory_order_acquire));
+
+    unclaim(idx, cur | Entry::REPLACING);
+  }
+
+  // Mark replaced slot `idx` HOLLOW once its own value is destroyed; an
+  // erased one is left to retire()
+  void hollow(std::size_t idx)
+  {
+    auto& state = data[idx].state;
+    Safe_Slot::Word cur = state.load(std::memory_order_acquire);
+
+    do
+    {
+      if (cur & Safe_Slot::LOCKED)
+      {
+        cur = settle(idx);
+      }
+
+      if (Entry::state_of(cur) != Entry::READY || !(cur & Entry::ALIASED))
+      {
+        return;
+      }
+    } while (!compare_exchange(state,
+      cur, cur | Entry::HOLLOW,
+      std::memory_order_acq_rel,
+      std::memory_order_acquire));
+  }
+
+  // State of `idx` as readers see it: a word locked by a transaction reads
+  // as its value before or after the commit
+  Safe_Slot::Word load_state(std::size_t idx) const
+  {
+    const auto& state = data[idx].state;
+    Safe_Slot::Word st = state.load(std::memory_order_acquire);
+    Safe_Mcas::View v;
+
+    while (st & Safe_Slot::LOCKED)
+    {
+      if (Safe_Mcas::inspect(state, st, false, v))
+      {
+        return v.succeeded ? v.desired : v.expected;
+      }
+
+      st = state.load(std::memory_order_acquire);
+    }
+
+    return st;
+  }
+
+  // Unlock `idx` before writing it: abort the owning transaction if it is
+  // undecided, write back the resolved value and finish its side effects.
+  // Returns the unlocked state.
+  Safe_Slot::Word settle(std::size_t idx)
+  {
+    auto& state = data[idx].state;
+    Safe_Slot::Word st = state.load(std::memory_order_acquire);
+    Safe_Mcas::View v;
+
+    while (st & Safe_Slot::LOCKED)
+    {
+      if (!Safe_Mcas::inspect(state, st, true, v))
+      {
+        st = state.load(std::memory_order_acquire);
+        continue;
+      }
+
+      Safe_Slot::Word next = v.succeeded ? v.desired : v.expected;
+
+      if (state.compare_exchange_strong(
+        st, next,
+        std::memory_order_acq_rel,
+        std::memory_order_acquire))
+      {
+        if (v.succeeded)
+        {
+          committed(idx, v.expected, next);
+        }
+
+        st = next;
+      }
+    }
+
+    return st;
+  }
+
+  // Finish an erase once `idx` is REMOVING
+  void removed(std::size_t idx, Safe_Slot::Word rem_st)
+  {
+    // A replaced value lives in a shadow slot; retire that too
+    if (rem_st & Entry::ALIASED)
+    {
+      unpublish_shadow(alias_of(idx, rem_st));
+    }
+
+    // Destroy now, or leave it to the last Guard / the pending replace
+    if (Entry::refs_of(rem_st) == 0 && !(rem_st & Entry::REPLACING))
+    {
+      retire(idx, rem_st, !(rem_st & Entry::ALIASED));
+    }
+  }
+
+  // Reclaim the value `idx` published at `prev_st` once a replace swung it
+  void replaced(std::size_t idx, Safe_Slot::Word prev_st)
+  {
+    if (prev_st & Entry::ALIASED)
+    {
+      unpublish_shadow(alias_of(idx, prev_st));
+    }
+    else if (Entry::refs_of(prev_st) == 0)
+    {
+      reinterpret_cast<T*>(&data[idx].storage)->~T(); // Else the last Guard does
+      hollow(idx);
+    }
+  }
+
+  // erase() on a SINGLE_WRITER array. Only the writer moves a live slot's
+  // state, and no transaction can hold it locked between writes, so
+  // READY -> REMOVING is one fetch_add that keeps the pins and WATCHED
+  // readers add meanwhile. An unpinned, unreplaced slot goes straight back
+  // to the writer's own free list.
+  bool erase_single(std::size_t idx, Safe_Slot::Word generation)
+  {
+    Entry& e = data[idx];
+    Safe_Slot::Word st = e.state.load(std::memory_order_acquire);
+
+    if (Entry::state_of(st) != Entry::READY ||
+      (generation != Safe_Slot::ANY_GENERATION && Entry::generation_of(st) != generation))
+    {
+      return false;
+    }
+
+    Safe_Slot::Word prev =
+      fetch_add(e.state, Entry::REMOVING - Entry::READY, std::memory_order_acq_rel);
+    Safe_Slot::Word rem_st = prev + (Entry::REMOVING - Entry::READY);
+
+    notify(idx, prev);
+    publish(Safe_Change_Op::ERASE, idx, Entry::generation_of(rem_st));
+
+    if (Entry::refs_of(rem_st) != 0 || (rem_st & (Entry::ALIASED | Entry::REPLACING)))
+    {
+      removed(idx, rem_st);
+      return true;
+    }
+
+    reinterpret_cast<T*>(&e.storage)->~T();
+    publish_empty(idx, rem_st);
+    feed_freed(idx);
+    push_local_index(idx);
+    return true;
+  }
+
+  // Side effects of a committed transaction word, run by whichever thread
+  // writes it back
+  void committed(std::size_t idx, Safe_Slot::Word before, Safe_Slot::Word after)
+  {
+    Safe_Slot::Word generation = Entry::generation_of(after);
+
+    notify(idx, before);
+
+    if (Entry::state_of(after) == Entry::REMOVING)
+    {
+      publish(Safe_Change_Op::ERASE, idx, generation);
+      removed(idx, after);
+    }
+    else if (Entry::state_of(before) == Entry::READY)
+    {
+      publish(Safe_Change_Op::REPLACE, idx, generation);
+      replaced(idx, before);
+      unclaim(idx, after);
+    }
+    else
+    {
+      // INIT -> READY: an insert, nothing left to do
+      publish(Safe_Change_Op::INSERT, idx, generation);
+    }
+  }
+
+  // Build T(args...) in a free slot, call prepare(idx, value, generation)
+  // while it is still invisible, and publish it READY, already holding
+  // `refs` pins (see insert_pinned). Returns false if full/raced.
+  template<typename Prepare, typename... Args>
+  bool emplace(Safe_Slot::Word refs, Prepare&& prepare, std::size_t& idx, Args&&... args)
+  {
+    Write_Scope scope(*this);
+    Safe_Slot::Word init_st;
+
+    // 1) Claim a free slot and construct T in-place
+    if (!build(idx, init_st, std::forward<Args>(args)...))
+    {
+      return false;
+    }
+
+    // 2) Bump counter, mark READY
+    Safe_Slot::Word ready_st = Entry::bump(init_st, Entry::READY) + refs;
+    feed_claimed(idx);
+    prepare(idx, static_cast<const T&>(*value_ptr(idx)), Entry::generation_of(ready_st));
+    data[idx].state.store(ready_st, std::memory_order_release);
+    notify(idx, init_st);
+    publish(Safe_Change_Op::INSERT, idx, Entry::generation_of(ready_st));
+    return true;
+  }
+
+public:
+  struct Op_Result
+  {
+    std::size_t index;
+    T& value;
+  };
+
+  // Insert an element by perfect-forwarding constructor args.
+  // Returns {index, reference} or nullopt if full/raced.
+  template<typename... Args>
+  std::optional<Op_Result> insert(Args&&... args)
+  {
+    return insert_prepared([](std::size_t, const T&, Safe_Slot::Word)
+    {
+    }, std::forward<Args>(args)...);
+  }
+
+  // insert() that calls prepare(index, value, generation) once the element
+  // is built, before it is published: only the inserter sees it, and
+  // `generation` is the one it is published at. For side tables indexed
+  // by slot that readers must find filled in.
+  template<typename Prepare, typename... Args>
+  std::optional<Op_Result> insert_prepared(Prepare&& prepare, Args&&... args)
+  {
+    std::size_t idx;
+
+    if (!emplace(0, prepare, idx, std::forward<Args>(args)...))
+    {
+      return std::nullopt;
+    }
+
+    return Op_Result{ idx, *value_ptr(idx) };
+  }
+
+  // Pinned reference to a live element, returned by acquire/acquire_if.
+  // While any Guard pins a slot, erase() only unpublishes it; the last Guard
+  // out destroys the element and frees the slot.
+  class Guard
+  {
+  public:
+    Guard(Guard&& other) noexcept
+      : owner(other.owner), idx(other.idx), phys(other.phys)
+    {
+      other.owner = nullptr;
+    }
+
+    Guard& operator=(Guard&& other) noexcept
+    {
+      if (this != &other)
+      {
+        reset();
+        owner = other.owner;
+        idx = other.idx;
+        phys = other.phys;
+        other.owner = nullptr;
+      }
+
+      return *this;
+    }
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+    ~Guard()
+    {
+      reset();
+    }
+
+    // Release the pin early
+    void reset()
+    {
+      if (owner)
+      {
+        owner->release(phys);
+        owner = nullptr;
+      }
+    }
+
+    std::size_t index() const
+    {
+      return idx;
+    }
+
+    T& operator*() const
+    {
+      return *owner->value_ptr(phys);
+    }
+
+    T* operator->() const
+    {
+      return owner->value_ptr(phys);
+    }
+
+  private:
+    friend class Safe_Array;
+
+    Guard(Safe_Array* owner, std::size_t idx, std::size_t phys)
+      : owner(owner), idx(idx), phys(phys)
+    {
+    }
+
+    Safe_Array* owner;
+    std::size_t idx;
+    std::size_t phys; // Slot actually pinned (differs once replaced)
+  };
+
+  // insert() that also pins the new element: the Guard holds it from the
+  // moment it becomes visible, so an erase cannot free (and a later insert
+  // reuse) the slot until the Guard is released
+  template<typename... Args>
+  std::optional<Guard> insert_pinned(Args&&... args)
+  {
+    return insert_pinned_prepared([](std::size_t, const T&, Safe_Slot::Word)
+    {
+    }, std::forward<Args>(args)...);
+  }
+
+  // insert_pinned() with a prepare step, as in insert_prepared()
+  template<typename Prepare, typename... Args>
+  std::optional<Guard> insert_pinned_prepared(Prepare&& prepare, Args&&... args)
+  {
+    std::size_t idx;
+
+    if (!emplace(Safe_Slot::REF_ONE, prepare, idx, std::forward<Args>(args)...))
+    {
+      return std::nullopt;
+    }
+
+    return Guard(this, idx, idx);
+  }
+
+  // Erase by index. Returns true if slot was READY (and, if given, still
+  // holds the element of `generation`). If the slot is pinned by a Guard,
+  // destruction is deferred to the last Guard.
+  bool erase(std::size_t idx, Safe_Slot::Word generation = Safe_Slot::ANY_GENERATION)
+  {
+    if (idx >= slot_count())
+    {
+      return false;
+    }
+
+    Write_Scope scope(*this);
+    Entry& e = data[idx];
+
+    if constexpr (SINGLE_WRITER)
+    {
+      return erase_single(idx, generation);
+    }
+
+    // 1) CAS READY -> REMOVING
+    Safe_Slot::Word old_st = e.state.load(std::memory_order_acquire);
+    Safe_Slot::Word rem_st;
+
+    do
+    {
+      if (old_st & Safe_Slot::LOCKED)
+      {
+        old_st = settle(idx);
+      }
+
+      if (Entry::state_of(old_st) != Entry::READY)
+      {
+        return false; // Nothing to erase
+      }
+
+      if (generation != Safe_Slot::ANY_GENERATION &&
+        Entry::generation_of(old_st) != generation)
+      {
+        return false; // Slot was reused
+      }
+
+      // Keep the reference count: pinned readers still release into it
+      rem_st = (old_st & ~(Entry::STATE_MASK | Entry::WATCHED)) | Entry::REMOVING;
+    } while (!compare_exchange(e.state,
+      old_st, rem_st,
+      std::memory_order_acq_rel,
+      std::memory_order_relaxed));
+
+    notify(idx, old_st);
+
+    publish(Safe_Change_Op::ERASE, idx, Entry::generation_of(rem_st));
+
+    // 2) Retire the value(s) now, or leave it to the last Guard
+    removed(idx, rem_st);
+    return true;
+  }
+
+  // Replace the element at `idx` with T(args...), RCU-style: the new value
+  // is built in a spare slot and published by one CAS that bumps the
+  // generation, so readers see either the old or the new value, never a
+  // gap, and the index stays the same. The old value is destroyed once no
+  // Guard pins it; the new one is then copied back into the element's own
+  // slot and the spare slot freed (see fold), so a replace needs one free
+  // slot while it runs and holds it only until the old value's Guards are
+  // released. For a T that cannot be copied, the spare slot stays in use
+  // until the element is erased. An unpinned reference to the new value
+  // (including the one returned) is valid only until that copy home.
+  // Returns {index, new value} or nullopt if the slot is not live, no
+  // spare slot is free, or a concurrent replace/erase (or fold) holds it.
+  template<typename... Args>
+  std::optional<Op_Result> replace(std::size_t idx, Args&&... args)
+  {
+    if (idx >= slot_count())
+    {
+      return std::nullopt;
+    }
+
+    Write_Scope scope(*this);
+    Entry& e = data[idx];
+    alias_words();
+
+    // 1) Claim the slot for replacing: READY -> READY | REPLACING
+    Safe_Slot::Word st = e.state.load(std::memory_order_acquire);
+
+    do
+    {
+      if (st & Safe_Slot::LOCKED)
+      {
+        st = settle(idx);
+      }
+
+      if (Entry::state_of(st) != Entry::READY || (st & Entry::REPLACING))
+      {
+        return std::nullopt;
+      }
+    } while (!compare_exchange(e.state,
+      st, st | Entry::REPLACING,
+      std::memory_order_acq_rel,
+      std::memory_order_acquire));
+
+    // 2) Construct the new value in a spare slot, then mark it SHADOW
+    std::size_t shadow;
+    Safe_Slot::Word init_st;
+
+    if (!build(shadow, init_st, std::forward<Args>(args)...))
+    {
+      unclaim(idx, st);
+      return std::nullopt;
+    }
+
+    T* ptr = value_ptr(shadow);
+    data[shadow].state.store(init_st | Entry::SHADOW, std::memory_order_release);
+
+    // 3) Record the shadow for the next generation
+    publish_alias(idx, st, shadow);
+
+    // 4) Swing: bump counter, set ALIASED (pins may change). The claim stays
+    //    until the old shadow is reclaimed: the next replace would reuse
+    //    its half of the alias pair.
+    Safe_Slot::Word cur = st | Entry::REPLACING;
+    Safe_Slot::Word next;
+
+    do
+    {
+      if (cur & Safe_Slot::LOCKED)
+      {
+        cur = settle(idx);
+      }
+
+      if (Entry::state_of(cur) != Entry::READY)
+      {
+        unpublish_shadow(shadow); // Erased meanwhile
+        unclaim(idx, st);
+        return std::nullopt;
+      }
+
+      next = ((cur & ~Entry::WATCHED) | Entry::ALIASED) + Safe_Slot::COUNTER_STEP;
+    } while (!compare_exchange(e.state,
+      cur, next,
+      std::memory_order_acq_rel,
+      std::memory_order_acquire));
+
+    notify(idx, cur);
+
+    publish(Safe_Change_Op::REPLACE, idx, Entry::generation_of(next));
+
+    // 5) Reclaim the previous value, then let the next replace in (moving
+    //    the new value home if the previous one is already gone)
+    replaced(idx, cur);
+
+    if (unclaim(idx, next))
+    {
+      ptr = value_ptr(idx);
+    }
+
+    return Op_Result{ idx, *ptr };
+  }
+
+  // All-or-nothing batch of erase/insert/replace steps, published by one
+  // multi-word CAS (Safe_Mcas) over the slots involved. New values are built
+  // when staged but stay invisible until commit(); if the commit fails, or
+  // the transaction is dropped uncommitted, they are destroyed again.
+  // Slots pinned by a Guard cannot take part (the commit fails).
+  class Transaction
+  {
+  public:
+    static constexpr std::size_t MAX_STEPS = Safe_Mcas::MAX_WORDS;
+
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+
+    ~Transaction()
+    {
+      if (owner)
+      {
+        Write_Scope scope(*owner); // Dropped uncommitted: frees what it staged
+        rollback();
+      }
+    }
+
+    // Stage erasing the element at `idx`
+    bool erase(std::size_t idx)
+    {
+      if (idx >= owner->slot_count() || !stage(idx))
+      {
+        return false;
+      }
+
+      steps[count++] = Step{ ERASE, idx, INVALID_INDEX };
+      return true;
+    }
+
+    // Stage inserting T(args...). Returns {index, reference}; the element
+    // becomes visible on commit.
+    template<typename... Args>
+    std::optional<Op_Result> insert(Args&&... args)
+    {
+      Write_Scope scope(*owner); // Takes a free slot
+      Step step{ INSERT, INVALID_INDEX, INVALID_INDEX };
+
+      if (!stage(INVALID_INDEX) ||
+        !owner->build(step.idx, step.init_st, std::forward<Args>(args)...))
+      {
+        return std::nullopt;
+      }
+
+      owner->feed_claimed(step.idx);
+      steps[count++] = step;
+      return Op_Result{ step.idx, *owner->value_ptr(step.idx) };
+    }
+
+    // Stage replacing the element at `idx` with T(args...), keeping the
+    // index (see Safe_Array::replace). Returns {index, new value}.
+    template<typename... Args>
+    std::optional<Op_Result> replace(std::size_t idx, Args&&... args)
+    {
+      Write_Scope scope(*owner); // Takes a free slot
+      Step step{ REPLACE, idx, INVALID_INDEX };
+      owner->alias_words();
+
+      if (idx >= owner->slot_count() || !stage(idx) ||
+        !owner->build(step.spare, step.init_st, std::forward<Args>(args)...))
+      {
+        return std::nullopt;
+      }
+
+      owner->data[step.spare].state.store(step.init_st | Entry::SHADOW, std::memory_order_release);
+      steps[count++] = step;
+      return Op_Result{ idx, *owner->value_ptr(step.spare) };
+    }
+
+    // Apply every staged step, or none. Returns false (and rolls back) if an
+    // erased or replaced slot is not live and unpinned at commit time, or a
+    // concurrent writer got in the way. A transaction commits at most once.
+    bool commit()
+    {
+      if (!owner)
+      {
+        return false;
+      }
+
+      Write_Scope scope(*owner);
+
+      // Lock in slot order, so competing transactions meet in the same order
+      std::sort(steps.begin(), steps.begin() + count, [](const Step& a, const Step& b)
+      {
+        return a.idx < b.idx;
+      });
+
+      if (!prepare() || !apply())
+      {
+        rollback();
+        return false;
+      }
+
+      owner = nullptr;
+      return true;
+    }
+
+  private:
+    friend class Safe_Array;
+
+    enum Kind
+    {
+      ERASE,
+      INSERT,
+      REPLACE
+    };
+
+    struct Step
+    {
+      Kind kind;
+      std::size_t idx;   // Slot whose state word the commit swaps
+      std::size_t spare; // Shadow slot holding a replacement value
+      Safe_Slot::Word init_st = 0;
+      Safe_Slot::Word expected = 0;
+      Safe_Slot::Word desired = 0;
+      bool claimed = false; // REPLACING taken on idx
+    };
+
+    explicit Transaction(Safe_Array* owner)
+      : owner(owner)
+    {
+    }
+
+    // Room for one more step on a slot not staged yet
+    bool stage(std::size_t idx) const
+    {
+      if (!owner || count == MAX_STEPS)
+      {
+        return false;
+      }
+
+      for (std::size_t k = 0; k < count; ++k)
+      {
+        if (steps[k].idx == idx && idx != INVALID_INDEX)
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    // Compute each word's expected and desired value; replaces claim their
+    // slot and record the shadow for the next generation first
+    bool prepare()
+    {
+      for (std::size_t k = 0; k < count; ++k)
+      {
+        Step& step = steps[k];
+
+        if (step.kind == INSERT)
+        {
+          step.expected = step.init_st;
+          step.desired = Entry::bump(step.init_st, Entry::READY);
+          continue;
+        }
+
+        auto& state = owner->data[step.idx].state;
+        Safe_Slot::Word st = owner->load_state(step.idx);
+
+        if (Entry::state_of(st) != Entry::READY || Entry::refs_of(st) != 0)
+        {
+          return false;
+        }
+
+        if (step.kind == ERASE)
+        {
+          step.expected = st;
+          step.desired = (st & ~(Entry::STATE_MASK | Entry::WATCHED)) | Entry::REMOVING;
+          continue;
+        }
+
+        do
+        {
+          if (st & Safe_Slot::LOCKED)
+          {
+            st = owner->settle(step.idx);
+          }
+
+          if (Entry::state_of(st) != Entry::READY || (st & Entry::REPLACING) ||
+            Entry::refs_of(st) != 0)
+          {
+            return false;
+          }
+        } while (!compare_exchange(state,
+          st, st | Entry::REPLACING,
+          std::memory_order_acq_rel,
+          std::memory_order_acquire));
+
+        step.claimed = true;
+        owner->publish_alias(step.idx, st, step.spare);
+        step.expected = st | Entry::REPLACING;
+        step.desired = ((st & ~Entry::WATCHED) | Entry::ALIASED | Entry::REPLACING) +
+          Safe_Slot::COUNTER_STEP;
+      }
+
+      return true;
+    }
+
+    // Multi-word CAS of every step's state word
+    bool apply()
+    {
+      if constexpr (UNSYNCHRONIZED)
+      {
+        // Nobody else can touch the slots: check every word, then write
+        for (std::size_t k = 0; k < count; ++k)
+        {
+          if (owner->data[steps[k].idx].state.load(std::memory_order_relaxed) != steps[k].expected)
+          {
+            return false;
+          }
+        }
+
+        for (std::size_t k = 0; k < count; ++k)
+        {
+          owner->data[steps[k].idx].state.store(steps[k].desired, std::memory_order_relaxed);
+          owner->committed(steps[k].idx, steps[k].expected, steps[k].desired);
+        }
+
+        return true;
+      }
+
+      std::size_t d = Safe_Mcas::acquire();
+      Safe_Slot::Word round = Safe_Mcas::begin(d);
+
+      for (std::size_t k = 0; k < count; ++k)
+      {
+        Safe_Mcas::add(d, owner->data[steps[k].idx].state, steps[k].expected, steps[k].desired);
+      }
+
+      // 1) Lock every word; a word that differs from its expected value fails
+      //    the transaction, one locked by another transaction gets settled
+      Safe_Slot::Word lock = Safe_Mcas::lock_word(d, round);
+      bool ok = true;
+
+      for (std::size_t k = 0; k < count && ok; ++k)
+      {
+        auto& state = owner->data[steps[k].idx].state;
+
+        for (;;)
+        {
+          if (!Safe_Mcas::undecided(d, round))
+          {
+            ok = false; // Aborted by a conflicting writer
+            break;
+          }
+
+          Safe_Slot::Word w = state.load(std::memory_order_acquire);
+
+          if (w & Safe_Slot::LOCKED)
+          {
+            owner->settle(steps[k].idx);
+            continue;
+          }
+
+          if (w != steps[k].expected)
+          {
+            ok = false;
+            break;
+          }
+
+          if (state.compare_exchange_strong(
+            w, lock,
+            std::memory_order_acq_rel,
+            std::memory_order_acquire))
+          {
+            break;
+          }
+        }
+      }
 
-private:
-  struct Entry
-  {
-    // Low 2 bits = state; upper bits = ABA counter
-    static constexpr std::uint32_t STATE_MASK = 0x3;
-    enum SlotState : std::uint32_t
+      // 2) Decide; this CAS is the linearization point
+      ok = Safe_Mcas::decide(d, round, ok ? Safe_Mcas::SUCCEEDED : Safe_Mcas::FAILED);
+
+      // 3) Write back the words nobody settled for us
+      for (std::size_t k = 0; k < count; ++k)
+      {
+        Safe_Slot::Word w = lock;
+        Safe_Slot::Word next = ok ? steps[k].desired : steps[k].expected;
+
+        if (owner->data[steps[k].idx].state.compare_exchange_strong(
+          w, next,
+          std::memory_order_acq_rel,
+          std::memory_order_relaxed) && ok)
+        {
+          owner->committed(steps[k].idx, steps[k].expected, next);
+        }
+      }
+
+      Safe_Mcas::release(d);
+      return ok;
+    }
+
+    // Destroy the values staged by an uncommitted transaction
+    void rollback()
     {
-      EMPTY = 0,
-      INIT = 1,
-      READY = 2,
-      REMOVING = 3
-    };
+      if (!owner)
+      {
+        return;
+      }
 
-    std::atomic<std::uint32_t> state{ EMPTY };
-    alignas(T) unsigned char storage[sizeof(T)];
-    std::atomic<std::size_t> next_free_index{ 0 };
-  };
+      for (std::size_t k = 0; k < count; ++k)
+      {
+        const Step& step = steps[k];
 
-  std::array<Entry, Capacity> data;
-  std::atomic<std::uint64_t> free_list_head;
-  static constexpr std::size_t INVALID_INDEX = Capacity;
+        if (step.kind == INSERT)
+        {
+          owner->retire(step.idx, step.init_st); // Never published
+        }
+        else if (step.kind == REPLACE)
+        {
+          owner->unpublish_shadow(step.spare);
 
-  std::uint64_t pack_index_counter(std::size_t idx, std::size_t ctr) const
+          if (step.claimed)
+          {
+            owner->unclaim(step.idx, step.expected);
+          }
+        }
+      }
+
+      owner = nullptr;
+    }
+
+    Safe_Array* owner;
+    std::array<Step, MAX_STEPS> steps{};
+    std::size_t count = 0;
+  };
+
+  // Start a transaction; see Transaction
+  Transaction transaction()
   {
-    return (std::uint64_t(ctr) << 32) | idx;
+    return Transaction(this);
   }
 
-  void unpack_index_counter(std::uint64_t v, std::size_t& idx, std::size_t& ctr) const
+  // Find with predicate
+  template<typename Predicate>
+  std::optional<Op_Result> find_if(Predicate pred) const
   {
-    idx = std::size_t(v & 0xFFFFFFFFULL);
-    ctr = std::size_t(v >> 32);
+    for (std::size_t i = 0, end = touched(); i < end; ++i)
+    {
+      prefetch_ahead<true>(i, end);
+      Safe_Slot::Word st = load_state(i);
+
+      if (Entry::state_of(st) == Entry::READY)
+      {
+        std::size_t p = physical(i, st);
+
+        if (p != INVALID_INDEX && pred(*value_ptr(p)))
+        {
+          return Op_Result{ i, *value_ptr(p) };
+        }
+      }
+    }
+
+    return std::nullopt;
   }
 
-  // Push a freed slot back onto the lock-free free-list
-  void push_free_index(std::size_t index)
+  // Find by value
+  std::optional<Op_Result> find(const T& value) const
   {
-    std::uint64_t old_head = free_list_head.load(std::memory_order_relaxed);
-    std::uint64_t new_head;
-    std::size_t old_idx, old_ctr;
+    return find_if([&](const T& v)
+    {
+      return v == value;
+    });
+  }
 
-    do
+  // Find by anything T compares equal to (a key, a string_view, ...),
+  // without constructing a T to compare against
+  template<typename K,
+    std::enable_if_t<Safe_Equality_Comparable<T, K>::value, int> = 0>
+  std::optional<Op_Result> find(const K& key) const
+  {
+    return find_if([&](const T& v)
     {
-      unpack_index_counter(old_head, old_idx, old_ctr);
-      data[index].next_free_index.store(old_idx, std::memory_order_relaxed);
-      new_head = pack_index_counter(index, old_ctr + 1);
-    } while (!free_list_head.compare_exchange_weak(
-      old_head, new_head,
-      std::memory_order_release,
-      std::memory_order_relaxed));
+      return v == key;
+    });
   }
 
-  // Pop a free slot; returns false if none remain
-  bool pop_free_index(std::size_t& index)
+  // Access by index
+  std::optional<Op_Result> at(std::size_t idx) const
   {
-    std::uint64_t old_head = free_list_head.load(std::memory_order_relaxed);
-    std::uint64_t new_head;
-    std::size_t old_idx, old_ctr;
+    if (idx >= slot_count())
+    {
+      return std::nullopt;
+    }
 
-    do
+    for (;;)
     {
-      unpack_index_counter(old_head, old_idx, old_ctr);
+      Safe_Slot::Word st = load_state(idx);
 
-      if (old_idx == INVALID_INDEX)
+      if (Entry::state_of(st) != Entry::READY)
       {
-        return false;
+        return std::nullopt;
       }
 
-      index = old_idx;
-      std::size_t next_idx = data[index].next_free_index.load(std::memory_order_relaxed);
+      std::size_t p = physical(idx, st);
 
-      new_head = pack_index_counter(next_idx, old_ctr + 1);
-    } while (!free_list_head.compare_exchange_weak(
-      old_head, new_head,
-      std::memory_order_acquire,
-      std::memory_order_relaxed));
+      if (p != INVALID_INDEX)
+      {
+        return Op_Result{ idx, *value_ptr(p) };
+      }
+    }
+  }
 
-    return true;
+  // at() for `count` indices at once, out[k] receiving the result for
+  // indices[k]. The slots are prefetched a window ahead of the lookups, so
+  // their cache misses overlap instead of queuing one behind the other.
+  // Returns how many were live.
+  std::size_t at_many(const std::size_t* indices, std::size_t count,
+    std::optional<Op_Result>* out) const
+  {
+    std::size_t found = 0;
+
+    batch(indices, count, [&](std::size_t k, std::optional<Op_Result> r)
+    {
+      found += r ? 1 : 0;
+
+      if (r)
+      {
+        out[k].emplace(*r);
+      }
+      else
+      {
+        out[k].reset();
+      }
+    });
+
+    return found;
   }
 
-public:
-  struct Op_Result
+  // Call f(index, value) for each live element among `indices`, in the
+  // order given, prefetching like at_many
+  template<typename Func>
+  void visit_many(const std::size_t* indices, std::size_t count, Func f) const
   {
-    std::size_t index;
-    T& value;
-  };
+    batch(indices, count, [&](std::size_t, std::optional<Op_Result> r)
+    {
+      if (r)
+      {
+        f(r->index, r->value);
+      }
+    });
+  }
 
-  // Insert an element by perfect-forwarding constructor args.
-  // Returns {index, reference} or nullopt if full/raced.
-  template<typename... Args>
-  std::optional<Op_Result> insert(Args&&... args)
+  // A live element chosen uniformly at random, or nullopt if there is none.
+  // Needs an occupancy-tracking Feed (Safe_Occupancy, safe_occupancy.h);
+  // draws again if the pick hits a slot that is changing, but gives up and
+  // returns nullopt after SAMPLE_ATTEMPTS (64) such draws, even though the
+  // array may not be empty.
+  template<typename Rng>
+  std::optional<Op_Result> sample(Rng& rng) const
   {
-    std::size_t idx;
-    if (!pop_free_index(idx))
+    for (int attempt = 0; attempt < SAMPLE_ATTEMPTS; ++attempt)
     {
-      return std::nullopt;
+      std::size_t idx = feed.pick(rng);
+
+      if (idx == Feed::NONE)
+      {
+        if (feed.live() == 0)
+        {
+          return std::nullopt;
+        }
+
+        continue;
+      }
+
+      if (auto r = at(idx))
+      {
+        return r;
+      }
     }
 
-    Entry& e = data[idx];
+    return std::nullopt;
+  }
 
-    // 1) CAS EMPTY -> INIT (capture current ABA counter)
-    std::uint32_t old_st = e.state.load(std::memory_order_relaxed);
-    std::uint32_t init_st;
+  // k independent sample() draws into out[0..k), with replacement: the
+  // same element may be drawn more than once. Returns how many were drawn:
+  // k, or fewer if the array is empty or a draw gave up (see sample).
+  template<typename Rng>
+  std::size_t sample_k(std::size_t k, Rng& rng, std::optional<Op_Result>* out) const
+  {
+    std::size_t drawn = 0;
 
-    do
+    for (; drawn < k; ++drawn)
     {
-      std::uint32_t ctr = old_st & ~Entry::STATE_MASK;
+      auto r = sample(rng);
 
-      if ((old_st & Entry::STATE_MASK) != Entry::EMPTY)
+      if (!r)
       {
-        return std::nullopt; // Racing fail
+        break;
       }
 
-      init_st = ctr | Entry::INIT;
-    } while (!e.state.compare_exchange_weak(
-      old_st, init_st,
-      std::memory_order_acq_rel,
-      std::memory_order_relaxed));
-
-    // 2) Construct T in-place
-    T* ptr = reinterpret_cast<T*>(&e.storage);
-    ::new (ptr) T(std::forward<Args>(args)...);
-
-    // 3) Bump counter, mark READY
-    std::uint32_t prev_ctr = init_st & ~Entry::STATE_MASK;
-    std::uint32_t bumped = (prev_ctr + (1u << 2)) & ~Entry::STATE_MASK;
-    e.state.store(bumped | Entry::READY, std::memory_order_release);
+      out[drawn].emplace(*r);
+    }
 
-    return Op_Result{ idx, *ptr };
+    return drawn;
   }
 
-  // Erase by index. Returns true if slot was READY.
-  bool erase(std::size_t idx)
+  // Pin the element at `idx`. Returns nullopt if the slot is not live
+  // (or, in the unlikely case, already pinned by REF_MAX guards).
+  std::optional<Guard> acquire(std::size_t idx) const
   {
-    if (idx >= Capacity)
+    if (idx >= slot_count())
     {
-      return false;
+      return std::nullopt;
     }
 
-    Entry& e = data[idx];
-
-    // 1) CAS READY -> REMOVING
-    std::uint32_t old_st = e.state.load(std::memory_order_acquire);
-    std::uint32_t rem_st;
+    Safe_Array* self = const_cast<Safe_Array*>(this);
 
-    do
+    for (;;)
     {
-      std::uint32_t state = old_st & Entry::STATE_MASK;
-      std::uint32_t ctr = old_st & ~Entry::STATE_MASK;
+      Safe_Slot::Word st = load_state(idx);
 
-      if (state != Entry::READY)
+      if (Entry::state_of(st) != Entry::READY)
       {
-        return false; // Nothing to erase
+        return std::nullopt;
       }
 
-      rem_st = ctr | Entry::REMOVING;
-    } while (!e.state.compare_exchange_weak(
-      old_st, rem_st,
-      std::memory_order_acq_rel,
-      std::memory_order_relaxed));
+      if (!(st & Entry::ALIASED))
+      {
+        if (self->pin(idx, Entry::STATE_MASK | Entry::ALIASED, Entry::READY))
+        {
+          return Guard(self, idx, idx);
+        }
+      }
+      else
+      {
+        // Pin the shadow slot holding the value; only valid if it is still
+        // the published one afterwards
+        std::size_t p = alias_of(idx, st);
+
+        if (self->pin(p, Entry::STATE_MASK | Entry::SHADOW, Entry::INIT | Entry::SHADOW))
+        {
+          if (unchanged(idx, st))
+          {
+            return Guard(self, idx, p);
+          }
 
-    // 2) Destroy in-place
-    T* ptr = reinterpret_cast<T*>(&e.storage);
-    ptr->~T();
+          self->release(p);
+        }
+      }
 
-    // 3) Bump counter, mark EMPTY
-    std::uint32_t prev_ctr = rem_st & ~Entry::STATE_MASK;
-    std::uint32_t bumped = (prev_ctr + (1u << 2)) & ~Entry::STATE_MASK;
-    e.state.store(bumped | Entry::EMPTY, std::memory_order_release);
+      std::size_t p = physical(idx, st);
 
-    // 4) Return slot to free list
-    push_free_index(idx);
-    return true;
+      if (p != INVALID_INDEX &&
+        Entry::refs_of(data[p].state.load(std::memory_order_relaxed)) == Safe_Slot::REF_MAX)
+      {
+        return std::nullopt;
+      }
+    }
   }
 
-  // Find with predicate
+  // Pin the first element matching the predicate. Each live element is
+  // pinned before pred sees it, so pred never reads one being destroyed.
   template<typename Predicate>
-  std::optional<Op_Result> find_if(Predicate pred) const
+  std::optional<Guard> acquire_if(Predicate pred) const
   {
-    for (std::size_t i = 0; i < Capacity; ++i)
+    for (std::size_t i = 0, end = touched(); i < end; ++i)
     {
-      std::uint32_t st = data[i].state.load(std::memory_order_acquire);
+      prefetch_ahead<true>(i, end);
 
-      if ((st & Entry::STATE_MASK) == Entry::READY)
+      if (Entry::state_of(load_state(i)) != Entry::READY)
       {
-        T* ptr = const_cast<T*>(reinterpret_cast<T const*>(&data[i].storage));
+        continue;
+      }
 
-        if (pred(*ptr))
-        {
-          return Op_Result{ i, *ptr };
-        }
+      auto g = acquire(i);
+
+      if (g && pred(**g))
+      {
+        return g;
       }
     }
 
     return std::nullopt;
   }
 
-  // Find by value
-  std::optional<Op_Result> find(const T& value) const
+  // The change feed this array publishes to
+  Feed& changes()
   {
-    return find_if([&](const T& v)
+    return feed;
+  }
+
+  const Feed& changes() const
+  {
+    return feed;
+  }
+
+  // Generation of the slot; changes on every insert, erase and replace
+  Safe_Slot::Word generation(std::size_t idx) const
+  {
+    if (idx >= slot_count())
     {
-      return v == value;
-    });
+      return Safe_Slot::ANY_GENERATION;
+    }
+
+    return Entry::generation_of(load_state(idx));
   }
 
-  // Access by index
-  std::optional<Op_Result> at(std::size_t idx) const
+  // Block until slot `idx` stops showing `observed_generation` (as read by
+  // generation()): its element of that generation is erased or replaced, or
+  // an empty slot is filled. Returns the generation shown then; loop on it
+  // to follow the slot. An erased element a Guard still pins already shows
+  // the generation its slot gets once freed, so the next wait parks until
+  // the slot is filled rather than returning again. Parks the thread with
+  // C++20 atomic wait, setting WATCHED so the writer that moves the slot on
+  // notifies; words that change without a notification (a slot still being
+  // built, one locked by a transaction) and pre-C++20 builds are polled
+  // instead. Under NONE there is no other thread to wait for; it returns at
+  // once.
+  Safe_Slot::Word wait_change(std::size_t idx, Safe_Slot::Word observed_generation)
   {
-    if (idx >= Capacity)
+    if (idx >= slot_count())
     {
-      return std::nullopt;
+      return Safe_Slot::ANY_GENERATION;
     }
 
-    std::uint32_t st = data[idx].state.load(std::memory_order_acquire);
+    auto& state = data[idx].state;
 
-    if ((st & Entry::STATE_MASK) != Entry::READY)
+    if constexpr (UNSYNCHRONIZED)
     {
-      return std::nullopt;
+      return shown_generation(state.load(std::memory_order_relaxed)); // Nobody else could change it
     }
 
-    T* ptr = const_cast<T*>(reinterpret_cast<T const*>(&data[idx].storage));
-    return Op_Result{ idx, *ptr };
+    for (;;)
+    {
+      Safe_Slot::Word st = state.load(std::memory_order_acquire);
+      Safe_Slot::Word shown = shown_generation((st & Safe_Slot::LOCKED) ? load_state(idx) : st);
+
+      if (shown != observed_generation)
+      {
+        return shown;
+      }
+
+#if defined(__cpp_lib_atomic_wait)
+      bool parkable = !(st & Safe_Slot::LOCKED) &&
+        (Entry::state_of(st) != Entry::INIT || (st & (Entry::WATCHED | Entry::SHADOW)));
+
+      if (!parkable)
+      {
+        std::this_thread::yield();
+      }
+      else if ((st & Entry::WATCHED) || compare_exchange(state,
+        st, st | Entry::WATCHED,
+        std::memory_order_acq_rel,
+        std::memory_order_acquire))
+      {
+        state.wait(st | Entry::WATCHED, std::memory_order_acquire);
+      }
+#else
+      std::this_thread::yield();
+#endif
+    }
+  }
+
+  // Live elements per the sharded insert/erase counters: O(shards), no
+  // scan. Exact when no write is in flight, else off by those in flight.
+  std::size_t approx_size() const
+  {
+    Safe_Slot::Word sum = 0;
+
+    for (const Size_Shard& shard : size_shards)
+    {
+      sum += shard.delta.load(std::memory_order_relaxed);
+    }
+
+    // Negative while an erase is counted ahead of its insert
+    std::int64_t n = std::int64_t(sum);
+    return n > 0 ? std::size_t(n) : 0;
+  }
+
+  // Attach `w` (nullptr detaches): it is told approx_size() now, and again
+  // by a writer whenever its shard's count reaches a multiple of
+  // watch_stride(), so it lags the true size by at most about 1/64 of the
+  // capacity (and by nothing on small arrays). `w` must stay alive until
+  // detached and no write is in flight.
+  void watch(Safe_Size_Watcher* w)
+  {
+    watcher.store(w, std::memory_order_release);
+
+    if (w)
+    {
+      w->update(approx_size());
+    }
+  }
+
+  // Live elements at a single instant (linearizable). Scans the slots twice
+  // and retries until both passes saw every slot in the same state and
+  // generation; as generations only move forward, nothing changed between
+  // the passes. Allocates one word per slot ever used, and keeps retrying
+  // for as long as writes land during every pair of passes.
+  std::size_t exact_size() const
+  {
+    std::vector<Safe_Slot::Word> seen;
+
+    for (;;)
+    {
+      std::size_t end = touched();
+      std::size_t cnt = 0;
+      seen.resize(end);
+
+      for (std::size_t i = 0; i < end; ++i)
+      {
+        Safe_Slot::Word st = load_state(i);
+        seen[i] = (Entry::generation_of(st) << 2) | Entry::state_of(st);
+        cnt += Entry::state_of(st) == Entry::READY ? 1 : 0;
+      }
+
+      bool same = true;
+
+      for (std::size_t i = 0; i < end && same; ++i)
+      {
+        Safe_Slot::Word st = load_state(i);
+        same = ((Entry::generation_of(st) << 2) | Entry::state_of(st)) == seen[i];
+      }
+
+      // A slot claimed past `end` meanwhile would have moved touched()
+      if (same && touched() == end)
+      {
+        return cnt;
+      }
+    }
   }
 
-  // Count live elements (O(Capacity))
+  // Count live elements (O(slots ever used); each slot counted as it is
+  // passed, so not a snapshot under writes; see approx_size, exact_size)
   std::size_t size() const
   {
     std::size_t cnt = 0;
 
-    for (std::size_t i = 0; i < Capacity; ++i)
+    for (std::size_t i = 0, end = touched(); i < end; ++i)
     {
-      std::uint32_t st = data[i].state.load(std::memory_order_acquire);
+      prefetch_ahead<false>(i, end);
+      Safe_Slot::Word st = load_state(i);
 
-      if ((st & Entry::STATE_MASK) == Entry::READY)
+      if (Entry::state_of(st) == Entry::READY)
       {
         ++cnt;
       }
@@ -266,15 +2692,38 @@ public:
 
   constexpr std::size_t capacity() const
   {
-    return Capacity;
+    return slot_count();
+  }
+
+  // Slots [0, touched()) may hold elements; scans stop there, so a large
+  // array that is mostly unused never faults in its tail
+  std::size_t touched() const
+  {
+    return std::min(untouched.load(std::memory_order_acquire), slot_count());
+  }
+
+  // Where the entry block of a Safe_Dynamic_Capacity array came from
+  // (nullptr for a fixed Capacity, whose entries are inline)
+  std::pmr::memory_resource* resource() const
+  {
+    if constexpr (DYNAMIC)
+    {
+      return data.resource;
+    }
+    else
+    {
+      return nullptr;
+    }
   }
 
   // Call f(index, value) for every live element.
   template<typename Func>
   void for_each(Func f) const
   {
-    for (std::size_t i = 0; i < Capacity; ++i)
+    for (std::size_t i = 0, end = touched(); i < end; ++i)
     {
+      prefetch_ahead<true>(i, end);
+
       if (auto opt = at(i))
       {
         f(opt->index, opt->value);
@@ -282,28 +2731,62 @@ public:
     }
   }
 
-  Safe_Array()
+  // Constant: `constinit static Safe_Array<...>` needs no runtime setup
+  // and lives in .bss (with a Feed that is constant-initializable too:
+  // Safe_No_Feed is, Safe_Change_Feed is not)
+  constexpr Safe_Array()
+  {
+  }
+
+  // Safe_Dynamic_Capacity only: `capacity` slots, their entry block (the
+  // array's only per-slot storage) allocated from `resource`, which must
+  // outlive the array. Throws std::length_error if `capacity` does not fit
+  // in 32 bits (or the feed), else whatever the resource throws.
+  template<bool Dynamic = DYNAMIC, std::enable_if_t<Dynamic, int> = 0>
+  explicit Safe_Array(std::size_t capacity,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
   {
-    // Initialize free list: 0->1->2->…->INVALID_INDEX
-    for (std::size_t i = 0; i < Capacity - 1; ++i)
+    // Slot indices are packed into 32-bit halves (alias pairs, the feed)
+    if (capacity >= 0xFFFFFFFFULL || capacity > Feed::MAX_SLOTS)
+    {
+      throw std::length_error("Safe_Array capacity must fit in 32 bits");
+    }
+
+    data.count = capacity;
+    data.resource = resource;
+
+    if (auto* constructing = dynamic_cast<Safe_Constructing_Resource*>(resource))
     {
-      data[i].next_free_index.store(i + 1, std::memory_order_relaxed);
+      data.entries = static_cast<Entry*>(constructing->allocate_constructed(
+        capacity, sizeof(Entry), alignof(Entry), &construct_entries));
+      return;
     }
 
-    data[Capacity - 1]
-      .next_free_index.store(INVALID_INDEX, std::memory_order_relaxed);
-    free_list_head.store(pack_index_counter(0, 0), std::memory_order_relaxed);
+    data.entries = static_cast<Entry*>(
+      resource->allocate(capacity * sizeof(Entry), alignof(Entry)));
+    construct_entries(data.entries, capacity);
   }
 
   ~Safe_Array()
   {
-    for (std::size_t i = 0; i < Capacity; ++i)
+    for (std::size_t i = 0, end = touched(); i < end; ++i)
     {
-      std::uint32_t st = data[i].state.load(std::memory_order_acquire);
+      Safe_Slot::Word st = data[i].state.load(std::memory_order_acquire);
+
+      if (Entry::state_of(st) == Entry::READY)
+      {
+        value_ptr(physical(i, st))->~T();
+      }
+    }
 
-      if ((st & Entry::STATE_MASK) == Entry::READY)
+    delete[] aliases.load(std::memory_order_relaxed);
+
+    // Past their elements, entries hold only atomics: no destructor to run
+    if constexpr (DYNAMIC)
+    {
+      if (data.entries)
       {
-        reinterpret_cast<T*>(&data[i].storage)->~T();
+        data.resource->deallocate(data.entries, data.count * sizeof(Entry), alignof(Entry));
       }
     }
   }
@@ -0,0 +1,185 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+#ifndef LOCKFREE_THREADSAFE_CHANGE_FEED
+#define LOCKFREE_THREADSAFE_CHANGE_FEED
+
+#include "safe_array.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+
+// Change-data-capture ring for Safe_Array: pass it as the Feed parameter
+// (Safe_Array<T, N, Safe_Change_Feed<R>>) and every insert, erase and
+// replace publishes an (op, index, generation) record. Publishing is
+// wait-free (one fetch_add, two stores) and never waits for subscribers.
+// Each subscriber reads at its own pace through a Cursor; a subscriber that
+// falls more than Ring_Capacity records behind loses records, is told so,
+// and must resync from a snapshot. It takes the array's only Feed
+// parameter, so an array with a change feed has no sample() (which needs
+// Safe_Occupancy there).
+template<std::size_t Ring_Capacity>
+class Safe_Change_Feed
+{
+  static_assert(Ring_Capacity > 0, "Ring_Capacity must be non-zero");
+
+public:
+  static constexpr std::size_t MAX_SLOTS = 0xFFFFFFFFULL;
+
+  struct Change
+  {
+    Safe_Change_Op op;
+    std::size_t index;
+    Safe_Slot::Word generation;
+  };
+
+  // Read position of one subscriber
+  class Cursor
+  {
+    std::uint64_t next = 0;
+    bool overflowed = false;
+
+    friend class Safe_Change_Feed;
+
+  public:
+    // True once records were overwritten before this cursor read them;
+    // poll() returns nullopt until the cursor is resynced
+    bool lost() const
+    {
+      return overflowed;
+    }
+  };
+
+private:
+  // A record is two words, each tagged with the lap (ticket / Ring_Capacity)
+  // that wrote it, so a reader can tell a finished record from one still
+  // being written or already overwritten, without a lock or sequence word:
+  //   what: bits 0-31 = slot index; bits 32-33 = op; bits 34-63 = lap
+  //   when: bits 0-31 = generation; bits 34-63 = lap
+  static constexpr std::uint64_t LAP_SHIFT = 34;
+  static constexpr std::uint64_t LAP_MASK = (std::uint64_t(1) << (64 - LAP_SHIFT)) - 1;
+  static constexpr std::uint64_t LOW_MASK = 0xFFFFFFFFULL;
+
+  struct Cell
+  {
+    std::atomic<std::uint64_t> what;
+    std::atomic<std::uint64_t> when;
+  };
+
+  std::array<Cell, Ring_Capacity> cells;
+  alignas(64) std::atomic<std::uint64_t> head{ 0 };
+
+  static std::uint64_t lap_of(std::uint64_t ticket)
+  {
+    return (ticket / Ring_Capacity) & LAP_MASK;
+  }
+
+  // Signed lap distance tag - lap, wrapping with the tag width
+  static std::int64_t lap_distance(std::uint64_t word, std::uint64_t lap)
+  {
+    constexpr std::uint64_t SHIFT = LAP_SHIFT;
+    std::uint64_t diff = (word >> LAP_SHIFT) - lap;
+    return std::int64_t(diff << SHIFT) >> SHIFT;
+  }
+
+public:
+  // Record a change. Called by Safe_Array.
+  void publish(Safe_Change_Op op, std::size_t index, Safe_Slot::Word generation)
+  {
+    std::uint64_t ticket = head.fetch_add(1, std::memory_order_relaxed);
+    std::uint64_t lap = lap_of(ticket) << LAP_SHIFT;
+    Cell& c = cells[std::size_t(ticket % Ring_Capacity)];
+
+    c.what.store(lap | (std::uint64_t(op) << 32) | (std::uint64_t(index) & LOW_MASK),
+      std::memory_order_release);
+    c.when.store(lap | (generation & LOW_MASK), std::memory_order_release);
+  }
+
+  // A cursor positioned after every record published so far. To (re)sync
+  // a replica: take the cursor first, then snapshot the array, then apply
+  // polled changes whose generation is newer than the snapshot's.
+  Cursor subscribe() const
+  {
+    Cursor cursor;
+    cursor.next = head.load(std::memory_order_acquire);
+    return cursor;
+  }
+
+  // Start over after lost records (see subscribe)
+  void resync(Cursor& cursor) const
+  {
+    cursor = subscribe();
+  }
+
+  // Next change for `cursor`, or nullopt if there is none yet (or the
+  // next record is still being written, or records were lost)
+  std::optional<Change> poll(Cursor& cursor) const
+  {
+    if (cursor.overflowed)
+    {
+      return std::nullopt;
+    }
+
+    std::uint64_t ticket = cursor.next;
+
+    if (ticket >= head.load(std::memory_order_acquire))
+    {
+      return std::nullopt;
+    }
+
+    const Cell& c = cells[std::size_t(ticket % Ring_Capacity)];
+    std::uint64_t lap = lap_of(ticket);
+    std::uint64_t when = c.when.load(std::memory_order_acquire);
+    std::uint64_t what = c.what.load(std::memory_order_acquire);
+    std::int64_t when_lap = lap_distance(when, lap);
+    std::int64_t what_lap = lap_distance(what, lap);
+
+    if (when_lap > 0 || what_lap > 0)
+    {
+      cursor.overflowed = true; // Overwritten by a later lap
+      return std::nullopt;
+    }
+
+    if (when_lap < 0 || what_lap < 0)
+    {
+      return std::nullopt; // Claimed but not written yet
+    }
+
+    cursor.next = ticket + 1;
+
+    return Change{
+      Safe_Change_Op((what >> 32) & 0x3),
+      std::size_t(what & LOW_MASK),
+      when & LOW_MASK };
+  }
+
+  // Number of records published so far
+  std::uint64_t published() const
+  {
+    return head.load(std::memory_order_acquire);
+  }
+
+  constexpr std::size_t capacity() const
+  {
+    return Ring_Capacity;
+  }
+
+  // Not constexpr: the ring is tagged at run time, so an array with this
+  // feed cannot be constinit
+  Safe_Change_Feed()
+  {
+    // Tag every cell with lap -1, so ticket 0 does not read as written
+    for (auto& c : cells)
+    {
+      c.what.store(LAP_MASK << LAP_SHIFT, std::memory_order_relaxed);
+      c.when.store(LAP_MASK << LAP_SHIFT, std::memory_order_relaxed);
+    }
+  }
+};
+
+#endif // LOCKFREE_THREADSAFE_CHANGE_FEED
@@ -0,0 +1,206 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+#ifndef LOCKFREE_THREADSAFE_CLOCK_CACHE
+#define LOCKFREE_THREADSAFE_CLOCK_CACHE
+
+#include "safe_array.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Safe_Array that evicts instead of failing when full. Each slot has a CLOCK
+// reference bit, set on access; a shared clock hand sweeps the slots,
+// clearing set bits (second chance) and erasing the first unreferenced
+// element it finds. The freed slot goes to the head of the free list, so the
+// insert that triggered the eviction normally reuses it.
+//
+// Any insert may evict any unpinned element, so the references at(), find()
+// and insert() return are only safe to read while no other thread inserts.
+// Concurrent readers take a Guard (acquire, acquire_if, insert_pinned): an
+// evicted element it pins stays intact until the Guard is released.
+template<typename T, std::size_t Capacity>
+class Safe_Clock_Cache
+{
+public:
+  using Op_Result = typename Safe_Array<T, Capacity>::Op_Result;
+  using Guard = typename Safe_Array<T, Capacity>::Guard;
+
+private:
+  Safe_Array<T, Capacity> items;
+  mutable std::array<std::atomic<bool>, Capacity> referenced{};
+  std::atomic<std::size_t> hand{ 0 };
+
+  // Only write when the bit is clear, so hits on hot slots stay read-only
+  void touch(std::size_t idx) const
+  {
+    if (!referenced[idx].load(std::memory_order_relaxed))
+    {
+      referenced[idx].store(true, std::memory_order_relaxed);
+    }
+  }
+
+  std::optional<Op_Result> touched(std::optional<Op_Result> r) const
+  {
+    if (r)
+    {
+      touch(r->index);
+    }
+
+    return r;
+  }
+
+  std::optional<Guard> touched(std::optional<Guard> g) const
+  {
+    if (g)
+    {
+      touch(g->index());
+    }
+
+    return g;
+  }
+
+public:
+  // Insert an element, evicting one if the cache is full.
+  // Returns {index, reference} or nullopt if nothing could be evicted.
+  template<typename... Args>
+  std::optional<Op_Result> insert(Args&&... args)
+  {
+    for (;;)
+    {
+      // Safe_Array::insert only consumes args once it owns a slot, so
+      // forwarding them again after a failed attempt is safe.
+      if (auto r = items.insert(std::forward<Args>(args)...))
+      {
+        referenced[r->index].store(true, std::memory_order_relaxed);
+        return r;
+      }
+
+      if (!evict())
+      {
+        return std::nullopt;
+      }
+    }
+  }
+
+  // insert() that also pins the new element, so no eviction can free it
+  // until the Guard is released
+  template<typename... Args>
+  std::optional<Guard> insert_pinned(Args&&... args)
+  {
+    for (;;)
+    {
+      if (auto g = items.insert_pinned(std::forward<Args>(args)...))
+      {
+        referenced[g->index()].store(true, std::memory_order_relaxed);
+        return g;
+      }
+
+      if (!evict())
+      {
+        return std::nullopt;
+      }
+    }
+  }
+
+  // Advance the clock hand until one element is evicted. Gives up after two
+  // full sweeps (every slot empty or constantly re-referenced).
+  bool evict()
+  {
+    for (std::size_t step = 0; step < 2 * Capacity; ++step)
+    {
+      std::size_t idx = hand.fetch_add(1, std::memory_order_relaxed) % Capacity;
+
+      if (!items.at(idx))
+      {
+        continue;
+      }
+
+      if (referenced[idx].load(std::memory_order_relaxed))
+      {
+        referenced[idx].store(false, std::memory_order_relaxed);
+        continue;
+      }
+
+      if (items.erase(idx))
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool erase(std::size_t idx)
+  {
+    return items.erase(idx);
+  }
+
+  // Access by index; marks the slot referenced. Not pinned: an insert may
+  // evict the element at any time; see acquire.
+  std::optional<Op_Result> at(std::size_t idx) const
+  {
+    return touched(items.at(idx));
+  }
+
+  // Pin the element at `idx`; marks the slot referenced
+  std::optional<Guard> acquire(std::size_t idx) const
+  {
+    return touched(items.acquire(idx));
+  }
+
+  // Pin the first element matching the predicate; marks it referenced
+  template<typename Predicate>
+  std::optional<Guard> acquire_if(Predicate pred) const
+  {
+    return touched(items.acquire_if(pred));
+  }
+
+  // Find with predicate; marks the match referenced. Not pinned, like at().
+  template<typename Predicate>
+  std::optional<Op_Result> find_if(Predicate pred) const
+  {
+    return touched(items.find_if(pred));
+  }
+
+  // Find by value; marks the match referenced
+  std::optional<Op_Result> find(const T& value) const
+  {
+    return touched(items.find(value));
+  }
+
+  // Find by anything T compares equal to; marks the match referenced
+  template<typename K,
+    std::enable_if_t<Safe_Equality_Comparable<T, K>::value, int> = 0>
+  std::optional<Op_Result> find(const K& key) const
+  {
+    return touched(items.find(key));
+  }
+
+  // Count live elements (O(Capacity))
+  std::size_t size() const
+  {
+    return items.size();
+  }
+
+  constexpr std::size_t capacity() const
+  {
+    return Capacity;
+  }
+
+  // Call f(index, value) for every live element. Does not mark references,
+  // nor pin: only safe while no other thread inserts.
+  template<typename Func>
+  void for_each(Func f) const
+  {
+    items.for_each(f);
+  }
+};
+
+#endif // LOCKFREE_THREADSAFE_CLOCK_CACHE
@@ -0,0 +1,299 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+#ifndef LOCKFREE_THREADSAFE_COLUMN_ARRAY
+#define LOCKFREE_THREADSAFE_COLUMN_ARRAY
+
+#include "safe_array.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Row reads race refills of their slot, which only atomic cells make safe
+#if !defined(__cpp_lib_atomic_ref)
+#error "safe_column_array.h requires C++20 std::atomic_ref"
+#endif
+
+// Safe_Array with a columnar layout for plain aggregates: each listed member
+// of T (Safe_Column_Array<Flow, N, &Flow::bytes, &Flow::latency>) lives in
+// its own contiguous, cache-line aligned array indexed by slot, so a scan
+// over one field reads only that field's memory. at() hands out a Row proxy
+// instead of a T&; for_each_column feeds runs of live slots as plain
+// pointer + count ranges that vectorize.
+//
+// Slots are Safe_Word_Slots, with no payload. Columns hold trivially
+// copyable values and are simply overwritten on reuse. A Row hands out
+// copies checked against the slot word, so it never shows another
+// element's values; a column range is plain memory and, like an unpinned
+// Safe_Array reference, may show the newer element's values if read while
+// its slot is erased and refilled.
+template<typename T, std::size_t Capacity, auto... Members>
+class Safe_Column_Array
+{
+  template<typename M, typename C>
+  static M member_type_of(M C::*);
+
+  template<auto Member>
+  using Member_Type = decltype(member_type_of(Member));
+
+  static_assert(std::is_aggregate<T>::value, "T must be an aggregate");
+  static_assert(sizeof...(Members) > 0, "List at least one member of T");
+  static_assert((std::is_same<decltype(Members), Member_Type<Members> T::*>::value && ...),
+    "Members must be data member pointers of T");
+  static_assert((std::is_trivially_copyable<Member_Type<Members>>::value && ...),
+    "Column members must be trivially copyable");
+  static_assert(((std::atomic_ref<Member_Type<Members>>::is_always_lock_free &&
+    std::atomic_ref<Member_Type<Members>>::required_alignment <= alignof(Member_Type<Members>)) && ...),
+    "Column members must be lock free through std::atomic_ref at their own alignment");
+
+private:
+  using Word = Safe_Slot::Word;
+
+  template<auto Member>
+  struct Column
+  {
+    alignas(64) std::array<Member_Type<Member>, Capacity> data{};
+  };
+
+  // One base per member (listing a member twice fails to compile)
+  struct Columns : Column<Members>...
+  {
+  };
+
+  Safe_Word_Slots<Capacity> slots;
+  mutable Columns columns{};
+
+  template<auto Member>
+  std::array<Member_Type<Member>, Capacity>& column() const
+  {
+    return static_cast<Column<Member>&>(columns).data;
+  }
+
+  template<typename... Args>
+  static T make_value(Args&&... args)
+  {
+    if constexpr (std::is_constructible<T, Args&&...>::value)
+    {
+      return T(std::forward<Args>(args)...);
+    }
+    else
+    {
+      return T{ std::forward<Args>(args)... };
+    }
+  }
+
+  bool live(std::size_t idx) const
+  {
+    return slots.live(idx);
+  }
+
+  // Single cells are read and written through atomic_ref (lock free, see
+  // the static_assert above), so a Row read racing a refill of its slot is
+  // no data race; the columns stay plain arrays for for_each_column
+  template<typename M>
+  static M load_cell(const M& cell)
+  {
+    return std::atomic_ref<M>(const_cast<M&>(cell)).load(std::memory_order_relaxed);
+  }
+
+  template<typename M>
+  static void store_cell(M& cell, const M& value)
+  {
+    std::atomic_ref<M>(cell).store(value, std::memory_order_relaxed);
+  }
+
+public:
+  // Proxy for the element a slot held when the Row was made. Members are
+  // handed out by copy, each checked against the slot word like a seqlock:
+  // once the element is erased the Row reads nothing.
+  class Row
+  {
+    const Safe_Column_Array* owner;
+    std::size_t idx;
+    Word st; // Slot word the element was published with
+
+    friend class Safe_Column_Array;
+
+    Row(const Safe_Column_Array* owner, std::size_t idx, Word st)
+      : owner(owner), idx(idx), st(st)
+    {
+    }
+
+    bool unchanged() const
+    {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return owner->slots.load(idx) == st;
+    }
+
+  public:
+    // Copy of the member, e.g. row.get<&Flow::bytes>(); nullopt if the
+    // element has been erased
+    template<auto Member>
+    std::optional<Member_Type<Member>> get() const
+    {
+      Member_Type<Member> value = load_cell(owner->template column<Member>()[idx]);
+
+      if (!unchanged())
+      {
+        return std::nullopt;
+      }
+
+      return value;
+    }
+
+    // Gather the listed members into a T (others value-initialized);
+    // nullopt if the element has been erased
+    std::optional<T> load() const
+    {
+      T value{};
+      ((value.*Members = load_cell(owner->template column<Members>()[idx])), ...);
+
+      if (!unchanged())
+      {
+        return std::nullopt;
+      }
+
+      return value;
+    }
+
+    std::size_t index() const
+    {
+      return idx;
+    }
+  };
+
+  struct Op_Result
+  {
+    std::size_t index;
+    Row value;
+  };
+
+  // Insert T(args...), scattered into the columns before the slot is
+  // published. Returns {index, row} or nullopt if full.
+  template<typename... Args>
+  std::optional<Op_Result> insert(Args&&... args)
+  {
+    T value = make_value(std::forward<Args>(args)...);
+    std::size_t idx;
+
+    if (!slots.claim(idx))
+    {
+      return std::nullopt;
+    }
+
+    ((store_cell(column<Members>()[idx], value.*Members)), ...);
+    return Op_Result{ idx, Row(this, idx, slots.publish(idx, 0)) };
+  }
+
+  // Erase by index (and, if given, generation). Returns true if the slot
+  // held an element.
+  bool erase(std::size_t idx, Word generation = Safe_Slot::ANY_GENERATION)
+  {
+    return slots.erase(idx, generation);
+  }
+
+  // Row proxy for the element at `idx` if live
+  std::optional<Op_Result> at(std::size_t idx) const
+  {
+    if (idx >= Capacity)
+    {
+      return std::nullopt;
+    }
+
+    Word st = slots.load(idx);
+
+    if (Safe_Slot::state_of(st) != Safe_Slot::READY)
+    {
+      return std::nullopt;
+    }
+
+    return Op_Result{ idx, Row(this, idx, st) };
+  }
+
+  // Find with a predicate over rows
+  template<typename Predicate>
+  std::optional<Op_Result> find_if(Predicate pred) const
+  {
+    for (std::size_t i = 0, end = slots.touched(); i < end; ++i)
+    {
+      auto r = at(i);
+
+      if (r && pred(static_cast<const Row&>(r->value)))
+      {
+        return r;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  // Generation of the slot (30 bits, wrapping); changes on every insert
+  // and erase
+  Word generation(std::size_t idx) const
+  {
+    return slots.generation(idx);
+  }
+
+  // Count live elements (O(slots ever used))
+  std::size_t size() const
+  {
+    return slots.size();
+  }
+
+  constexpr std::size_t capacity() const
+  {
+    return Capacity;
+  }
+
+  // Call f(index, row) for every live element
+  template<typename Func>
+  void for_each(Func f) const
+  {
+    for (std::size_t i = 0, end = slots.touched(); i < end; ++i)
+    {
+      if (auto r = at(i))
+      {
+        f(i, r->value);
+      }
+    }
+  }
+
+  // Call f(first_index, data, count) for each run of consecutive live slots,
+  // where data points at `count` contiguous values of Member: one call for
+  // a densely filled table, ready for a vectorized loop
+  template<auto Member, typename Func>
+  void for_each_column(Func f) const
+  {
+    const Member_Type<Member>* data = column<Member>().data();
+
+    for (std::size_t i = 0, end = slots.touched(); i < end;)
+    {
+      if (!live(i))
+      {
+        ++i;
+        continue;
+      }
+
+      std::size_t first = i;
+
+      while (i < end && live(i))
+      {
+        ++i;
+      }
+
+      f(first, data + first, i - first);
+    }
+  }
+
+  constexpr Safe_Column_Array()
+  {
+  }
+};
+
+#endif // LOCKFREE_THREADSAFE_COLUMN_ARRAY
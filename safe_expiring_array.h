@@ -0,0 +1,467 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+#ifndef LOCKFREE_THREADSAFE_EXPIRING_ARRAY
+#define LOCKFREE_THREADSAFE_EXPIRING_ARRAY
+
+#include "safe_array.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+// Safe_Array with optional per-slot deadlines. Expired slots read as absent
+// immediately (lazy expiry); reap() erases them through a hierarchical timer
+// wheel indexed by slot, so its cost is O(expired + deadlines set + ticks
+// elapsed) rather than O(Capacity).
+template<typename T, std::size_t Capacity, typename Clock = std::chrono::steady_clock>
+class Safe_Expiring_Array
+{
+public:
+  using Op_Result = typename Safe_Array<T, Capacity>::Op_Result;
+  using time_point = typename Clock::time_point;
+  using duration = typename Clock::duration;
+
+private:
+  static constexpr std::size_t INVALID_INDEX = Capacity;
+
+  // 4 levels of 64 buckets cover 2^24 ticks; longer deadlines are cascaded
+  // down from the top level as the wheel turns.
+  static constexpr std::size_t WHEEL_BITS = 6;
+  static constexpr std::size_t WHEEL_SIZE = std::size_t(1) << WHEEL_BITS;
+  static constexpr std::size_t WHEEL_LEVELS = 4;
+  static constexpr std::size_t BUCKET_COUNT = WHEEL_SIZE * WHEEL_LEVELS;
+  static constexpr std::uint64_t WHEEL_SPAN = std::uint64_t(1) << (WHEEL_BITS * WHEEL_LEVELS);
+
+  // An element and its deadline tick (0 = none). The deadline lives and
+  // dies with the element, so it can never be mistaken for the deadline of
+  // a later element in the same slot.
+  struct Timed
+  {
+    std::atomic<std::uint64_t> deadline;
+    T value;
+
+    template<typename... Args>
+    Timed(std::uint64_t deadline, Args&&... args)
+      : deadline(deadline), value(std::forward<Args>(args)...)
+    {
+    }
+  };
+
+  Safe_Array<Timed, Capacity> items;
+
+  // Slots whose deadline was set since the last reap: a Treiber stack
+  // threaded through inbox_next, each slot on it at most once (queued).
+  std::atomic<std::size_t> inbox{ INVALID_INDEX };
+  std::array<std::atomic<std::size_t>, Capacity> inbox_next{};
+  std::array<std::atomic<bool>, Capacity> queued{};
+
+  // Timer wheel, touched only by the thread holding `reaping`: each bucket
+  // is a doubly linked list of slot indices, so a slot can be moved to an
+  // earlier bucket when its deadline is brought forward.
+  std::array<std::size_t, BUCKET_COUNT> wheel;
+  std::array<std::size_t, Capacity> wheel_next;
+  std::array<std::size_t, Capacity> wheel_prev;
+  std::array<std::size_t, Capacity> filed_in; // Bucket, or BUCKET_COUNT
+  std::uint64_t wheel_tick; // Next tick to process
+  std::atomic_flag reaping = ATOMIC_FLAG_INIT;
+  duration tick;
+
+  std::uint64_t ticks_of(time_point tp) const
+  {
+    return std::uint64_t(tp.time_since_epoch() / tick);
+  }
+
+  // Round up, so an element never expires before its deadline
+  std::uint64_t deadline_ticks_of(time_point tp) const
+  {
+    duration since = tp.time_since_epoch();
+    std::uint64_t t = std::uint64_t(since / tick);
+    return since % tick != duration::zero() ? t + 1 : t;
+  }
+
+  static bool is_expired(std::uint64_t deadline, std::uint64_t now)
+  {
+    return deadline != 0 && deadline <= now;
+  }
+
+  // The deadline is read off the pinned element, so it is that element's.
+  // The pin ends on return: like Safe_Array::at, the reference is unpinned.
+  std::optional<Op_Result> live(std::size_t idx, std::uint64_t now) const
+  {
+    auto node = items.acquire(idx);
+
+    if (!node || is_expired((*node)->deadline.load(std::memory_order_acquire), now))
+    {
+      return std::nullopt;
+    }
+
+    return Op_Result{ idx, (*node)->value };
+  }
+
+  // Scan filter on a plain state load, so only live slots get pinned. The
+  // deadline is left to live(): read unpinned, it could race the
+  // construction of a later element in the same storage.
+  bool occupied(std::size_t idx) const
+  {
+    return items.at(idx).has_value();
+  }
+
+  // Queue slot `idx` for the reaper to (re)file by its current deadline
+  void schedule(std::size_t idx)
+  {
+    if (queued[idx].exchange(true, std::memory_order_seq_cst))
+    {
+      return;
+    }
+
+    std::size_t head = inbox.load(std::memory_order_relaxed);
+
+    do
+    {
+      inbox_next[idx].store(head, std::memory_order_relaxed);
+    } while (!inbox.compare_exchange_weak(
+      head, idx,
+      std::memory_order_release,
+      std::memory_order_relaxed));
+  }
+
+  void link(std::size_t bucket, std::size_t idx)
+  {
+    std::size_t head = wheel[bucket];
+    wheel_prev[idx] = INVALID_INDEX;
+    wheel_next[idx] = head;
+
+    if (head != INVALID_INDEX)
+    {
+      wheel_prev[head] = idx;
+    }
+
+    wheel[bucket] = idx;
+    filed_in[idx] = bucket;
+  }
+
+  void unlink(std::size_t idx)
+  {
+    std::size_t bucket = filed_in[idx];
+
+    if (bucket == BUCKET_COUNT)
+    {
+      return;
+    }
+
+    std::size_t prev = wheel_prev[idx];
+    std::size_t next = wheel_next[idx];
+
+    if (prev == INVALID_INDEX)
+    {
+      wheel[bucket] = next;
+    }
+    else
+    {
+      wheel_next[prev] = next;
+    }
+
+    if (next != INVALID_INDEX)
+    {
+      wheel_prev[next] = prev;
+    }
+
+    filed_in[idx] = BUCKET_COUNT;
+  }
+
+  // File slot `idx` in the bucket matching `deadline` relative to the
+  // current wheel position
+  void place(std::size_t idx, std::uint64_t deadline)
+  {
+    std::uint64_t now = wheel_tick;
+
+    if (deadline < now)
+    {
+      deadline = now;
+    }
+
+    if (deadline - now >= WHEEL_SPAN)
+    {
+      deadline = now + WHEEL_SPAN - 1;
+    }
+
+    std::size_t level = 0;
+
+    while (level + 1 < WHEEL_LEVELS &&
+      deadline - now >= (std::uint64_t(1) << (WHEEL_BITS * (level + 1))))
+    {
+      ++level;
+    }
+
+    std::size_t bucket = std::size_t(deadline >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1);
+    link(level * WHEEL_SIZE + bucket, idx);
+  }
+
+  // Look at the element now in slot `idx` (already unfiled): erase it if it
+  // expired by tick `now`, else file it by its deadline, if it has one.
+  // Returns 1 if it was erased.
+  std::size_t refile(std::size_t idx, std::uint64_t now)
+  {
+    auto node = items.acquire(idx);
+
+    if (!node)
+    {
+      return 0;
+    }
+
+    std::uint64_t deadline = (*node)->deadline.load(std::memory_order_seq_cst);
+
+    if (is_expired(deadline, now))
+    {
+      // Pinned, so the generation is still that of the element we read
+      return items.erase(idx, items.generation(idx)) ? 1 : 0;
+    }
+
+    if (deadline != 0)
+    {
+      place(idx, deadline);
+    }
+
+    return 0;
+  }
+
+  // File every slot scheduled since the last call, moving any already
+  // filed under an older deadline
+  std::size_t drain_inbox(std::uint64_t now)
+  {
+    std::size_t expired = 0;
+    std::size_t idx = inbox.exchange(INVALID_INDEX, std::memory_order_acquire);
+
+    while (idx != INVALID_INDEX)
+    {
+      std::size_t next = inbox_next[idx].load(std::memory_order_relaxed);
+
+      // Dequeue before reading the deadline: a concurrent schedule() either
+      // sees the flag clear and queues the slot again, or we see its deadline.
+      queued[idx].store(false, std::memory_order_seq_cst);
+      unlink(idx);
+      expired += refile(idx, now);
+      idx = next;
+    }
+
+    return expired;
+  }
+
+  // Take every slot out of `bucket`; expire the due ones, re-file the rest
+  std::size_t process(std::size_t bucket, std::uint64_t now)
+  {
+    std::size_t expired = 0;
+    std::size_t idx = wheel[bucket];
+    wheel[bucket] = INVALID_INDEX;
+
+    while (idx != INVALID_INDEX)
+    {
+      std::size_t next = wheel_next[idx];
+      filed_in[idx] = BUCKET_COUNT;
+      expired += refile(idx, now);
+      idx = next;
+    }
+
+    return expired;
+  }
+
+  template<typename... Args>
+  std::optional<Op_Result> insert_deadline(std::uint64_t deadline, Args&&... args)
+  {
+    auto r = items.insert(deadline, std::forward<Args>(args)...);
+
+    if (!r)
+    {
+      return std::nullopt;
+    }
+
+    schedule(r->index);
+    return Op_Result{ r->index, r->value.value };
+  }
+
+public:
+  // Insert without a deadline
+  template<typename... Args>
+  std::optional<Op_Result> insert(Args&&... args)
+  {
+    auto r = items.insert(std::uint64_t(0), std::forward<Args>(args)...);
+
+    if (!r)
+    {
+      return std::nullopt;
+    }
+
+    return Op_Result{ r->index, r->value.value };
+  }
+
+  // Insert an element that expires at `deadline`
+  template<typename... Args>
+  std::optional<Op_Result> insert_until(time_point deadline, Args&&... args)
+  {
+    return insert_deadline(deadline_ticks_of(deadline), std::forward<Args>(args)...);
+  }
+
+  // Insert an element that expires `ttl` from now
+  template<typename... Args>
+  std::optional<Op_Result> insert_for(duration ttl, Args&&... args)
+  {
+    return insert_until(Clock::now() + ttl, std::forward<Args>(args)...);
+  }
+
+  // Set, refresh or bring forward the deadline of a live element. Returns
+  // false if the slot is empty or already expired.
+  bool expire_at(std::size_t idx, time_point deadline)
+  {
+    auto node = items.acquire(idx);
+
+    if (!node ||
+      is_expired((*node)->deadline.load(std::memory_order_acquire), ticks_of(Clock::now())))
+    {
+      return false;
+    }
+
+    (*node)->deadline.store(deadline_ticks_of(deadline), std::memory_order_seq_cst);
+    schedule(idx);
+    return true;
+  }
+
+  // Erase by index. Returns true if the slot was live (expired or not).
+  bool erase(std::size_t idx)
+  {
+    return items.erase(idx);
+  }
+
+  // Access by index; expired elements read as absent. The reference is
+  // unpinned, as from Safe_Array::at.
+  std::optional<Op_Result> at(std::size_t idx, time_point now = Clock::now()) const
+  {
+    return live(idx, ticks_of(now));
+  }
+
+  // Find the first unexpired element matching the predicate
+  template<typename Predicate>
+  std::optional<Op_Result> find_if(Predicate pred) const
+  {
+    std::uint64_t now = ticks_of(Clock::now());
+
+    for (std::size_t i = 0, end = items.touched(); i < end; ++i)
+    {
+      if (!occupied(i))
+      {
+        continue;
+      }
+
+      auto r = live(i, now);
+
+      if (r && pred(r->value))
+      {
+        return r;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  // Call f(index, value) for every unexpired element.
+  template<typename Func>
+  void for_each(Func f) const
+  {
+    std::uint64_t now = ticks_of(Clock::now());
+
+    for (std::size_t i = 0, end = items.touched(); i < end; ++i)
+    {
+      if (!occupied(i))
+      {
+        continue;
+      }
+
+      if (auto r = live(i, now))
+      {
+        f(r->index, r->value);
+      }
+    }
+  }
+
+  // Count unexpired elements (O(slots ever used); not a snapshot under
+  // writes)
+  std::size_t size() const
+  {
+    std::uint64_t now = ticks_of(Clock::now());
+    std::size_t cnt = 0;
+
+    for (std::size_t i = 0, end = items.touched(); i < end; ++i)
+    {
+      if (occupied(i) && live(i, now))
+      {
+        ++cnt;
+      }
+    }
+
+    return cnt;
+  }
+
+  constexpr std::size_t capacity() const
+  {
+    return Capacity;
+  }
+
+  // Advance the wheel to `now` and erase the elements that expired on the
+  // way. Returns the number erased. Only one thread reaps at a time; a
+  // concurrent call returns 0 immediately. A deadline set while a reap is
+  // running may wait for the next one, but it reads as absent on time.
+  std::size_t reap(time_point now = Clock::now())
+  {
+    if (reaping.test_and_set(std::memory_order_acquire))
+    {
+      return 0;
+    }
+
+    std::uint64_t target = ticks_of(now);
+    std::size_t expired = drain_inbox(target);
+
+    for (std::uint64_t t = wheel_tick; t <= target; ++t)
+    {
+      wheel_tick = t;
+
+      // Cascade higher levels whose period starts at this tick
+      for (std::size_t level = WHEEL_LEVELS - 1; level > 0; --level)
+      {
+        std::uint64_t period = std::uint64_t(1) << (WHEEL_BITS * level);
+
+        if ((t & (period - 1)) == 0)
+        {
+          std::size_t bucket = std::size_t(t >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1);
+          expired += process(level * WHEEL_SIZE + bucket, t);
+        }
+      }
+
+      expired += process(std::size_t(t) & (WHEEL_SIZE - 1), t);
+    }
+
+    if (wheel_tick <= target)
+    {
+      wheel_tick = target + 1;
+    }
+
+    reaping.clear(std::memory_order_release);
+    return expired;
+  }
+
+  // `tick` is the wheel resolution; reap() costs one step per elapsed tick.
+  explicit Safe_Expiring_Array(duration tick = std::chrono::milliseconds(1))
+    : tick(tick)
+  {
+    wheel.fill(INVALID_INDEX);
+    filed_in.fill(BUCKET_COUNT);
+    wheel_tick = ticks_of(Clock::now());
+  }
+};
+
+#endif // LOCKFREE_THREADSAFE_EXPIRING_ARRAY
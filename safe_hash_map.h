@@ -0,0 +1,383 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+#ifndef LOCKFREE_THREADSAFE_HASH_MAP
+#define LOCKFREE_THREADSAFE_HASH_MAP
+
+#include "safe_array.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Fixed-capacity lock-free hash map. Nodes live in-place in a Safe_Array,
+// buckets are lock-free ordered lists (Harris/Michael) linked by slot index.
+// With a Hash and Key_Equal that both declare is_transparent, find/erase/
+// insert hash and compare the lookup key as given (e.g. a string_view for
+// std::string keys); otherwise it is converted to K once per call.
+template<typename K, typename V, std::size_t Capacity,
+  typename Hash = std::hash<K>, typename Key_Equal = std::equal_to<K>>
+class Safe_Hash_Map
+{
+  static_assert(Capacity < 0xFFFFFFFFULL,
+    "Capacity must fit in 32 bits");
+
+private:
+  struct Node
+  {
+    K key;
+    V value;
+
+    template<typename Key, typename... Args>
+    Node(Key&& k, Args&&... args)
+      : key(std::forward<Key>(k)), value(std::forward<Args>(args)...)
+    {
+    }
+  };
+
+  static constexpr std::size_t round_up_pow2(std::size_t n)
+  {
+    std::size_t p = 1;
+
+    while (p < n)
+    {
+      p <<= 1;
+    }
+
+    return p;
+  }
+
+  static constexpr std::size_t BUCKET_COUNT = round_up_pow2(Capacity);
+  static constexpr std::size_t INVALID_INDEX = Capacity;
+
+  // Link word: low 32 bits = slot index; bit 32 = deletion mark;
+  // upper bits = version, bumped on every write to defeat ABA on slot reuse.
+  static constexpr std::uint64_t INDEX_MASK = 0xFFFFFFFFULL;
+  static constexpr std::uint64_t MARK_BIT = 1ULL << 32;
+  static constexpr std::uint64_t VERSION_STEP = 1ULL << 33;
+
+  Safe_Array<Node, Capacity> nodes;
+
+public:
+  // Pinned node (guard->key, guard->value); see Safe_Array::Guard
+  using Guard = typename Safe_Array<Node, Capacity>::Guard;
+
+private:
+  std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> buckets{};
+  std::array<std::atomic<std::uint64_t>, Capacity> links{};
+  std::array<std::atomic<std::size_t>, Capacity> hashes{};
+  Hash hasher;
+  Key_Equal key_equal;
+
+  template<typename F, typename = void>
+  struct is_transparent : std::false_type
+  {
+  };
+
+  template<typename F>
+  struct is_transparent<F, std::void_t<typename F::is_transparent>> : std::true_type
+  {
+  };
+
+  static constexpr bool TRANSPARENT =
+    is_transparent<Hash>::value && is_transparent<Key_Equal>::value;
+
+  // `key` as the hasher and key_equal should see it: as is if they are
+  // transparent (or it already is a K), else converted to K once rather
+  // than once per hash and per comparison
+  template<typename Key>
+  static decltype(auto) lookup_key(const Key& key)
+  {
+    if constexpr (TRANSPARENT || std::is_same<Key, K>::value)
+    {
+      return (key);
+    }
+    else
+    {
+      return K(key);
+    }
+  }
+
+  static std::size_t index_of(std::uint64_t link)
+  {
+    return std::size_t(link & INDEX_MASK);
+  }
+
+  static bool is_marked(std::uint64_t link)
+  {
+    return (link & MARK_BIT) != 0;
+  }
+
+  // Next version of `link` pointing at `idx`
+  static std::uint64_t relink(std::uint64_t link, std::size_t idx, bool mark = false)
+  {
+    std::uint64_t version = (link & ~(INDEX_MASK | MARK_BIT)) + VERSION_STEP;
+    return version | (mark ? MARK_BIT : 0) | std::uint64_t(idx);
+  }
+
+  struct Position
+  {
+    std::atomic<std::uint64_t>* prev;
+    std::uint64_t prev_link;
+    std::size_t curr;
+    std::uint64_t curr_link;
+    std::optional<Guard> node; // curr, pinned, if its key matched
+    bool found;
+  };
+
+  std::atomic<std::uint64_t>& bucket_for(std::size_t hash)
+  {
+    return buckets[hash & (BUCKET_COUNT - 1)];
+  }
+
+  // Locate the first node with (hash, key) >= the search key, unlinking and
+  // freeing marked nodes on the way. Every read of a node is validated by
+  // re-reading its predecessor link, so a recycled slot forces a restart.
+  // A key is only compared on a pinned node whose predecessor still links
+  // it, so it cannot be destroyed or recycled under the comparison.
+  template<typename Key>
+  Position locate(std::size_t hash, const Key& key)
+  {
+  retry:
+    std::atomic<std::uint64_t>* prev = &bucket_for(hash);
+    std::uint64_t prev_link = prev->load(std::memory_order_acquire);
+
+    for (;;)
+    {
+      std::size_t curr = index_of(prev_link);
+
+      if (curr == INVALID_INDEX)
+      {
+        return Position{ prev, prev_link, curr, 0, std::nullopt, false };
+      }
+
+      std::uint64_t curr_link = links[curr].load(std::memory_order_acquire);
+      std::size_t curr_hash = hashes[curr].load(std::memory_order_relaxed);
+      std::optional<Guard> node;
+
+      if (curr_hash == hash && !is_marked(curr_link))
+      {
+        node = nodes.acquire(curr);
+
+        if (!node)
+        {
+          goto retry;
+        }
+      }
+
+      if (prev->load(std::memory_order_acquire) != prev_link)
+      {
+        goto retry;
+      }
+
+      bool equal = node && key_equal((*node)->key, key);
+
+      if (is_marked(curr_link))
+      {
+        std::uint64_t next_link = relink(prev_link, index_of(curr_link));
+
+        if (!prev->compare_exchange_strong(
+          prev_link, next_link,
+          std::memory_order_acq_rel,
+          std::memory_order_relaxed))
+        {
+          goto retry;
+        }
+
+        nodes.erase(curr);
+        prev_link = next_link;
+        continue;
+      }
+
+      if (curr_hash > hash || (curr_hash == hash && equal))
+      {
+        if (!equal)
+        {
+          node.reset();
+        }
+
+        return Position{ prev, prev_link, curr, curr_link, std::move(node), equal };
+      }
+
+      prev = &links[curr];
+      prev_link = curr_link;
+    }
+  }
+
+public:
+  struct Op_Result
+  {
+    std::size_t index;
+    const K& key;
+    V& value;
+  };
+
+  // Insert key -> V(args...). Returns {index, key, value} or nullopt if the
+  // key is already present or the map is full.
+  template<typename Key, typename... Args>
+  std::optional<Op_Result> insert(Key&& key, Args&&... args)
+  {
+    const auto& k = lookup_key(key);
+    std::size_t hash = hasher(k);
+    Position pos = locate(hash, k);
+
+    if (pos.found)
+    {
+      return std::nullopt;
+    }
+
+    auto r = nodes.insert(std::forward<Key>(key), std::forward<Args>(args)...);
+
+    if (!r)
+    {
+      return std::nullopt;
+    }
+
+    std::size_t idx = r->index;
+    hashes[idx].store(hash, std::memory_order_relaxed);
+
+    for (;;)
+    {
+      std::uint64_t own = links[idx].load(std::memory_order_relaxed);
+      links[idx].store(relink(own, pos.curr), std::memory_order_relaxed);
+
+      if (pos.prev->compare_exchange_strong(
+        pos.prev_link, relink(pos.prev_link, idx),
+        std::memory_order_acq_rel,
+        std::memory_order_relaxed))
+      {
+        return Op_Result{ idx, r->value.key, r->value.value };
+      }
+
+      pos = locate(hash, r->value.key);
+
+      if (pos.found)
+      {
+        nodes.erase(idx);
+        return std::nullopt;
+      }
+    }
+  }
+
+  // Erase by key. Returns true if the key was present.
+  template<typename Key>
+  bool erase(const Key& key)
+  {
+    const auto& k = lookup_key(key);
+    std::size_t hash = hasher(k);
+
+    for (;;)
+    {
+      Position pos = locate(hash, k);
+
+      if (!pos.found)
+      {
+        return false;
+      }
+
+      // 1) Logically delete by marking the node's own link
+      std::uint64_t marked = relink(pos.curr_link, index_of(pos.curr_link), true);
+
+      if (!links[pos.curr].compare_exchange_strong(
+        pos.curr_link, marked,
+        std::memory_order_acq_rel,
+        std::memory_order_relaxed))
+      {
+        continue;
+      }
+
+      // 2) Physically unlink; on failure a later traversal does it for us
+      if (pos.prev->compare_exchange_strong(
+        pos.prev_link, relink(pos.prev_link, index_of(pos.curr_link)),
+        std::memory_order_acq_rel,
+        std::memory_order_relaxed))
+      {
+        nodes.erase(pos.curr);
+      }
+      else
+      {
+        locate(hash, k);
+      }
+
+      return true;
+    }
+  }
+
+  // Find by key. Like at(), the reference is not pinned; see acquire.
+  template<typename Key>
+  std::optional<Op_Result> find(const Key& key)
+  {
+    auto node = acquire(key);
+
+    if (!node)
+    {
+      return std::nullopt;
+    }
+
+    return Op_Result{ node->index(), (*node)->key, (*node)->value };
+  }
+
+  // Pin the node holding `key`. Its key was compared while pinned, so the
+  // Guard holds that very node even if it is erased meanwhile.
+  template<typename Key>
+  std::optional<Guard> acquire(const Key& key)
+  {
+    const auto& k = lookup_key(key);
+    Position pos = locate(hasher(k), k);
+    return std::move(pos.node);
+  }
+
+  // Access by slot index
+  std::optional<Op_Result> at(std::size_t idx) const
+  {
+    auto r = nodes.at(idx);
+
+    if (!r)
+    {
+      return std::nullopt;
+    }
+
+    return Op_Result{ r->index, r->value.key, r->value.value };
+  }
+
+  // Number of live nodes (O(Capacity))
+  std::size_t size() const
+  {
+    return nodes.size();
+  }
+
+  constexpr std::size_t capacity() const
+  {
+    return Capacity;
+  }
+
+  // Call f(key, value) for every live, not logically deleted, element.
+  template<typename Func>
+  void for_each(Func f) const
+  {
+    nodes.for_each([&](std::size_t i, Node& n)
+    {
+      if (!is_marked(links[i].load(std::memory_order_acquire)))
+      {
+        f(n.key, n.value);
+      }
+    });
+  }
+
+  Safe_Hash_Map()
+  {
+    for (auto& b : buckets)
+    {
+      b.store(INVALID_INDEX, std::memory_order_relaxed);
+    }
+  }
+};
+
+#endif // LOCKFREE_THREADSAFE_HASH_MAP
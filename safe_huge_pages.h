@@ -0,0 +1,242 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+#ifndef LOCKFREE_THREADSAFE_HUGE_PAGES
+#define LOCKFREE_THREADSAFE_HUGE_PAGES
+
+#include "safe_array.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// memory_resource handing out 2 MB-page backed blocks, for the entry block
+// of a Safe_Dynamic_Capacity array:
+//   Safe_Huge_Page_Resource pages({ true });
+//   Safe_Array<Row, Safe_Dynamic_Capacity> table(n, &pages);
+// Random access across a multi-GB table then misses the TLB once per 2 MB
+// instead of once per 4 KB. Each allocation is its own mapping: explicit
+// huge pages (MAP_HUGETLB) if the system has them reserved, else a 2 MB
+// aligned mapping advised for transparent huge pages (MADV_HUGEPAGE), else
+// (not on Linux) plain aligned heap memory. Meant for a few large blocks,
+// not for many small ones. An array's entries are constructed in a pass
+// split over the prefault threads, which also faults the block in, so it
+// is the only pass over the block.
+class Safe_Huge_Page_Resource : public std::pmr::memory_resource, public Safe_Constructing_Resource
+{
+public:
+  static constexpr std::size_t HUGE_PAGE_SIZE = std::size_t(2) << 20;
+
+  struct Options
+  {
+    // Touch every page at allocation, split over `prefault_threads`
+    // threads (0 = one per hardware thread), so the first accesses do not
+    // take the page faults and a large block is zeroed in parallel. Blocks
+    // of constructed objects (allocate_constructed) are always built on
+    // that many threads.
+    bool prefault = false;
+    unsigned prefault_threads = 0;
+
+    // Try MAP_HUGETLB first; off = transparent huge pages only
+    bool explicit_huge_pages = true;
+  };
+
+private:
+  static constexpr std::size_t SMALL_PAGE_SIZE = 4096;
+
+  Options options;
+  std::atomic<std::size_t> hugetlb{ 0 };   // Bytes mapped with MAP_HUGETLB
+  std::atomic<std::size_t> fallback{ 0 };  // Bytes on transparent/normal pages
+
+  static std::size_t round_up(std::size_t bytes)
+  {
+    return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+  }
+
+  // Call run(first, last) over runs covering [0, n) of a `bytes` block,
+  // split over the prefault threads (at most one per huge page)
+  template<typename Run>
+  void split(std::size_t n, std::size_t bytes, Run run) const
+  {
+    unsigned threads = options.prefault_threads
+      ? options.prefault_threads
+      : std::max(1u, std::thread::hardware_concurrency());
+    threads = unsigned(std::min<std::size_t>(threads, std::max<std::size_t>(1, bytes / HUGE_PAGE_SIZE)));
+
+    auto part = [&run, n, threads](unsigned k)
+    {
+      run(n * k / threads, n * (k + 1) / threads);
+    };
+
+    std::vector<std::thread> workers;
+
+    for (unsigned k = 1; k < threads; ++k)
+    {
+      workers.emplace_back(part, k);
+    }
+
+    part(0);
+
+    for (auto& w : workers)
+    {
+      w.join();
+    }
+  }
+
+  void prefault(void* p, std::size_t bytes) const
+  {
+    volatile unsigned char* base = static_cast<unsigned char*>(p);
+
+    split(bytes / SMALL_PAGE_SIZE, bytes, [base](std::size_t first, std::size_t last)
+    {
+      for (std::size_t i = first; i < last; ++i)
+      {
+        base[i * SMALL_PAGE_SIZE] = 0;
+      }
+    });
+  }
+
+  // Map `size` bytes (a multiple of HUGE_PAGE_SIZE) on a 2 MB boundary
+  void* map(std::size_t size)
+  {
+#if defined(__linux__)
+#if defined(MAP_HUGETLB)
+    if (options.explicit_huge_pages)
+    {
+      void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+      if (p != MAP_FAILED)
+      {
+        hugetlb.fetch_add(size, std::memory_order_relaxed);
+        return p;
+      }
+    }
+#endif
+
+    // Over-map by one huge page and trim, so the block starts on a 2 MB
+    // boundary and THP can back all of it
+    void* raw = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (raw == MAP_FAILED)
+    {
+      throw std::bad_alloc();
+    }
+
+    std::uintptr_t start = std::uintptr_t(raw);
+    std::uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~std::uintptr_t(HUGE_PAGE_SIZE - 1);
+
+    if (aligned != start)
+    {
+      munmap(raw, aligned - start);
+    }
+
+    munmap(reinterpret_cast<void*>(aligned + size), start + HUGE_PAGE_SIZE - aligned);
+
+#if defined(MADV_HUGEPAGE)
+    madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+#endif
+
+    fallback.fetch_add(size, std::memory_order_relaxed);
+    return reinterpret_cast<void*>(aligned);
+#else
+    void* p = std::pmr::new_delete_resource()->allocate(size, HUGE_PAGE_SIZE);
+    fallback.fetch_add(size, std::memory_order_relaxed);
+    return p;
+#endif
+  }
+
+protected:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    if (alignment > HUGE_PAGE_SIZE)
+    {
+      throw std::bad_alloc();
+    }
+
+    std::size_t size = round_up(std::max<std::size_t>(bytes, 1));
+    void* p = map(size);
+
+    if (options.prefault)
+    {
+      prefault(p, size);
+    }
+
+    return p;
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t) override
+  {
+    std::size_t size = round_up(std::max<std::size_t>(bytes, 1));
+
+#if defined(__linux__)
+    munmap(p, size);
+#else
+    std::pmr::new_delete_resource()->deallocate(p, size, HUGE_PAGE_SIZE);
+#endif
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+  {
+    return this == &other;
+  }
+
+public:
+  Safe_Huge_Page_Resource()
+  {
+  }
+
+  explicit Safe_Huge_Page_Resource(Options options)
+    : options(options)
+  {
+  }
+
+  // Map a block for `count` objects and construct them in one pass split
+  // over the prefault threads; their writes fault the pages in, so there
+  // is no separate prefault
+  void* allocate_constructed(std::size_t count, std::size_t size,
+    std::size_t alignment, void (*construct)(void* first, std::size_t n)) override
+  {
+    if (alignment > HUGE_PAGE_SIZE)
+    {
+      throw std::bad_alloc();
+    }
+
+    std::size_t bytes = round_up(std::max<std::size_t>(count * size, 1));
+    unsigned char* p = static_cast<unsigned char*>(map(bytes));
+
+    split(count, bytes, [p, size, construct](std::size_t first, std::size_t last)
+    {
+      construct(p + first * size, last - first);
+    });
+
+    return p;
+  }
+
+  // Bytes ever mapped on explicit huge pages / on the fallback path (what
+  // actually got huge pages under THP is up to the kernel: see AnonHugePages
+  // in /proc/<pid>/smaps)
+  std::size_t hugetlb_bytes() const
+  {
+    return hugetlb.load(std::memory_order_relaxed);
+  }
+
+  std::size_t fallback_bytes() const
+  {
+    return fallback.load(std::memory_order_relaxed);
+  }
+};
+
+#endif // LOCKFREE_THREADSAFE_HUGE_PAGES
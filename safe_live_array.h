@@ -0,0 +1,530 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+#ifndef LOCKFREE_THREADSAFE_LIVE_ARRAY
+#define LOCKFREE_THREADSAFE_LIVE_ARRAY
+
+#include "safe_array.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+// Safe_Array with a live list: a lock-free list threaded through the slots
+// by index, in insertion order, so iteration costs O(live) instead of
+// O(Capacity). insert appends at the tail; erase marks the slot's link and
+// unlinks it through a predecessor hint, falling back to a sweep from the
+// head when the hint is stale.
+//
+// The list is singly linked (Harris-style marks on versioned index links,
+// as in Safe_Hash_Map); the backward links are only hints, since keeping
+// both directions exact would need multi-word updates. The list holds a pin
+// on every slot from insert until it is unlinked, so an erased slot is
+// never reused (nor its link reset) while anything can still reach it.
+template<typename T, std::size_t Capacity>
+class Safe_Live_Array
+{
+  static_assert(Capacity < 0xFFFFFFFFULL,
+    "Capacity must fit in 32 bits");
+
+public:
+  using Op_Result = typename Safe_Array<T, Capacity>::Op_Result;
+
+private:
+  using Guard = typename Safe_Array<T, Capacity>::Guard;
+
+  static constexpr std::size_t INVALID_INDEX = Capacity;
+
+  // Restarts a walk makes before finishing in slot order
+  static constexpr int MAX_RESTARTS = 64;
+
+  // Link word: low 32 bits = next slot index; bit 32 = deletion mark;
+  // bit 33 = pending (the slot is not linked yet, nothing may follow it);
+  // upper bits = version, bumped on every write to defeat ABA on reuse.
+  // A link with neither flag belongs to a slot that is in the list.
+  static constexpr std::uint64_t INDEX_MASK = 0xFFFFFFFFULL;
+  static constexpr std::uint64_t MARK_BIT = 1ULL << 32;
+  static constexpr std::uint64_t PENDING_BIT = 1ULL << 33;
+  static constexpr std::uint64_t VERSION_STEP = 1ULL << 34;
+
+  Safe_Array<T, Capacity> items;
+  std::atomic<std::uint64_t> head{ INVALID_INDEX };
+  std::array<std::atomic<std::uint64_t>, Capacity> links{};
+
+  // The list's pin on each slot, taken by insert and dropped by the snip
+  // that unlinks it
+  std::array<std::optional<Guard>, Capacity> holds{};
+
+  // Predecessor at link time, refreshed when it is unlinked (a hint)
+  std::array<std::atomic<std::size_t>, Capacity> prev_hint{};
+
+  // Position in insertion order; strictly increasing along the list, so an
+  // interrupted walk can resume where it left off
+  std::array<std::atomic<std::uint64_t>, Capacity> order{};
+
+  std::atomic<std::size_t> tail{ INVALID_INDEX }; // Last linked slot (a hint)
+  std::atomic<std::size_t> live{ 0 };
+
+  static std::size_t index_of(std::uint64_t link)
+  {
+    return std::size_t(link & INDEX_MASK);
+  }
+
+  static bool is_marked(std::uint64_t link)
+  {
+    return (link & MARK_BIT) != 0;
+  }
+
+  static bool is_pending(std::uint64_t link)
+  {
+    return (link & PENDING_BIT) != 0;
+  }
+
+  static bool in_list(std::uint64_t link)
+  {
+    return (link & (MARK_BIT | PENDING_BIT)) == 0;
+  }
+
+  // Next version of `link` pointing at `idx`, with `flags`
+  static std::uint64_t relink(std::uint64_t link, std::size_t idx, std::uint64_t flags = 0)
+  {
+    std::uint64_t version = (link & ~(INDEX_MASK | MARK_BIT | PENDING_BIT)) + VERSION_STEP;
+    return version | flags | std::uint64_t(idx);
+  }
+
+  const std::atomic<std::uint64_t>& link_at(std::size_t node) const
+  {
+    return node == INVALID_INDEX ? head : links[node];
+  }
+
+  std::atomic<std::uint64_t>& link_at(std::size_t node)
+  {
+    return node == INVALID_INDEX ? head : links[node];
+  }
+
+  // Unlink `node`, whose link `node_link` is marked, from `prev`. The
+  // caller read `node_link` after `prev_link`, and a marked link is frozen
+  // while it is reachable, so it is current if the CAS succeeds. On success
+  // `prev_link` is updated and the list's pin on the slot is dropped.
+  bool snip(std::size_t prev, std::uint64_t& prev_link, std::size_t node, std::uint64_t node_link)
+  {
+    std::size_t next = index_of(node_link);
+    std::uint64_t next_link = relink(prev_link, next);
+
+    if (!link_at(prev).compare_exchange_strong(
+      prev_link, next_link,
+      std::memory_order_acq_rel,
+      std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    prev_link = next_link;
+
+    if (next != INVALID_INDEX)
+    {
+      prev_hint[next].store(prev, std::memory_order_relaxed);
+    }
+    else
+    {
+      std::size_t last = node;
+      tail.compare_exchange_strong(last, prev, std::memory_order_release, std::memory_order_relaxed);
+    }
+
+    // Freed slots wait pending, ready for their next insert. The new
+    // version sets every stale view of the link apart from it.
+    links[node].store(relink(node_link, INVALID_INDEX, PENDING_BIT), std::memory_order_release);
+
+    // Out of holds before the pin drops: that may free the slot, and its
+    // next insert fills holds[node] again
+    std::optional<Guard> hold = std::exchange(holds[node], std::nullopt);
+    hold.reset();
+    return true;
+  }
+
+  // `node` was reached through a link, so it is linked: clear its pending
+  // flag for its inserter
+  void settle(std::size_t node, std::uint64_t node_link)
+  {
+    links[node].compare_exchange_strong(
+      node_link, relink(node_link, index_of(node_link)),
+      std::memory_order_acq_rel,
+      std::memory_order_relaxed);
+  }
+
+  // Last slot of the list and its link, unlinking and settling on the way.
+  // Starts from the tail hint if that slot is still in the list. Every read
+  // is validated by re-reading the predecessor link.
+  std::pair<std::size_t, std::uint64_t> find_last()
+  {
+  retry:
+    std::size_t prev = tail.load(std::memory_order_acquire);
+    std::uint64_t prev_link = link_at(prev).load(std::memory_order_acquire);
+
+    if (!in_list(prev_link))
+    {
+      prev = INVALID_INDEX;
+      prev_link = head.load(std::memory_order_acquire);
+    }
+
+    for (;;)
+    {
+      std::size_t curr = index_of(prev_link);
+
+      if (curr == INVALID_INDEX)
+      {
+        return { prev, prev_link };
+      }
+
+      std::uint64_t curr_link = links[curr].load(std::memory_order_acquire);
+
+      if (link_at(prev).load(std::memory_order_acquire) != prev_link)
+      {
+        goto retry;
+      }
+
+      if (is_marked(curr_link))
+      {
+        if (!snip(prev, prev_link, curr, curr_link))
+        {
+          goto retry;
+        }
+
+        continue;
+      }
+
+      if (is_pending(curr_link))
+      {
+        settle(curr, curr_link);
+        continue;
+      }
+
+      prev = curr;
+      prev_link = curr_link;
+    }
+  }
+
+  // Unlink `idx`, whose link is marked. Tries the predecessor hint first,
+  // then sweeps the list from the head. The slot may have been unlinked
+  // and reused meanwhile; then this only unlinks it again if it is marked.
+  void unlink(std::size_t idx)
+  {
+    if (!is_marked(links[idx].load(std::memory_order_acquire)))
+    {
+      return; // Already unlinked by a sweep (and maybe reused)
+    }
+
+    // The link of idx is read after the hint's link, as a sweep would; read
+    // before, it could belong to an earlier life of the slot and splice a
+    // successor from that life back in behind the hint
+    std::size_t prev = prev_hint[idx].load(std::memory_order_relaxed);
+    std::uint64_t prev_link = link_at(prev).load(std::memory_order_acquire);
+
+    if (index_of(prev_link) == idx && in_list(prev_link))
+    {
+      std::uint64_t idx_link = links[idx].load(std::memory_order_acquire);
+
+      if (is_marked(idx_link) && snip(prev, prev_link, idx, idx_link))
+      {
+        return;
+      }
+    }
+
+  retry:
+    prev = INVALID_INDEX;
+    prev_link = head.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+      std::size_t curr = index_of(prev_link);
+
+      if (curr == INVALID_INDEX)
+      {
+        return; // Someone else unlinked it
+      }
+
+      std::uint64_t curr_link = links[curr].load(std::memory_order_acquire);
+
+      if (link_at(prev).load(std::memory_order_acquire) != prev_link)
+      {
+        goto retry;
+      }
+
+      if (is_marked(curr_link))
+      {
+        if (!snip(prev, prev_link, curr, curr_link))
+        {
+          goto retry;
+        }
+
+        if (curr == idx)
+        {
+          return;
+        }
+
+        continue;
+      }
+
+      if (is_pending(curr_link))
+      {
+        settle(curr, curr_link);
+        continue;
+      }
+
+      prev = curr;
+      prev_link = curr_link;
+    }
+  }
+
+  // Visit live elements in insertion order while visit(index, value)
+  // returns true. Marked slots are passed over (their links are frozen), so
+  // reads are validated against the anchor, the last link followed that was
+  // in the list. Each element is pinned while visited; if the walk is cut
+  // short it restarts from the head and skips what it already visited.
+  // After MAX_RESTARTS restarts, it visits the rest in slot order.
+  template<typename Visit>
+  void walk(Visit visit) const
+  {
+    std::uint64_t visited = 0;
+    int restarts = -1;
+
+  restart:
+    if (++restarts > MAX_RESTARTS)
+    {
+      finish(visited, visit);
+      return;
+    }
+
+    std::size_t anchor = INVALID_INDEX;
+    std::uint64_t anchor_link = head.load(std::memory_order_acquire);
+    std::uint64_t prev_link = anchor_link;
+
+    for (;;)
+    {
+      std::size_t curr = index_of(prev_link);
+
+      if (curr == INVALID_INDEX)
+      {
+        return;
+      }
+
+      std::uint64_t curr_link = links[curr].load(std::memory_order_acquire);
+
+      if (link_at(anchor).load(std::memory_order_acquire) != anchor_link)
+      {
+        goto restart;
+      }
+
+      std::uint64_t position = order[curr].load(std::memory_order_relaxed);
+
+      if (!is_marked(curr_link) && position > visited)
+      {
+        // Still reachable once pinned, so still the element linked here;
+        // if it cannot be pinned, it was erased and is not marked yet
+        auto node = items.acquire(curr);
+
+        if (link_at(anchor).load(std::memory_order_acquire) != anchor_link)
+        {
+          goto restart;
+        }
+
+        if (node)
+        {
+          visited = position;
+
+          if (!visit(curr, **node))
+          {
+            return;
+          }
+        }
+      }
+
+      if (in_list(curr_link))
+      {
+        anchor = curr;
+        anchor_link = curr_link;
+      }
+
+      prev_link = curr_link;
+    }
+  }
+
+  // End of a walk that keeps being cut short: the elements after position
+  // `visited`, in slot order
+  template<typename Visit>
+  void finish(std::uint64_t visited, Visit visit) const
+  {
+    for (std::size_t i = 0; i < Capacity; ++i)
+    {
+      auto node = items.acquire(i);
+
+      if (node && !is_marked(links[i].load(std::memory_order_acquire)) &&
+        order[i].load(std::memory_order_relaxed) > visited && !visit(i, **node))
+      {
+        return;
+      }
+    }
+  }
+
+public:
+  // Insert an element and append it to the live list.
+  // Returns {index, reference} or nullopt if full.
+  template<typename... Args>
+  std::optional<Op_Result> insert(Args&&... args)
+  {
+    auto pinned = items.insert_pinned(std::forward<Args>(args)...);
+
+    if (!pinned)
+    {
+      return std::nullopt;
+    }
+
+    // The slot's link is pending (see snip), so nothing can be appended
+    // after it until it is linked. The pin becomes the list's.
+    std::size_t idx = pinned->index();
+    Op_Result r{ idx, **pinned };
+    std::uint64_t fresh = links[idx].load(std::memory_order_acquire) & ~MARK_BIT;
+    holds[idx].emplace(std::move(*pinned));
+    live.fetch_add(1, std::memory_order_relaxed);
+
+    for (;;)
+    {
+      auto [prev, prev_link] = find_last();
+
+      // prev_link is checked by the CAS below, so prev was not recycled
+      // between reading its order and linking after it
+      std::uint64_t position = prev == INVALID_INDEX ? 0 :
+        order[prev].load(std::memory_order_relaxed);
+
+      prev_hint[idx].store(prev, std::memory_order_relaxed);
+      order[idx].store(position + 1, std::memory_order_relaxed);
+
+      if (link_at(prev).compare_exchange_strong(
+        prev_link, relink(prev_link, idx),
+        std::memory_order_acq_rel,
+        std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+
+    tail.store(idx, std::memory_order_release);
+
+    // Clear pending, unless the link moved on: a traversal settled it (any
+    // later erase unlinks by itself), or an erase marked it while pending
+    // (maybe before `fresh` was read), leaving the unlink to us. Compared by
+    // version, so this can never touch a later life of the slot.
+    std::uint64_t own = fresh;
+
+    if (!links[idx].compare_exchange_strong(
+      own, relink(fresh, INVALID_INDEX),
+      std::memory_order_acq_rel,
+      std::memory_order_acquire) && own == (fresh | MARK_BIT))
+    {
+      unlink(idx);
+    }
+
+    return r;
+  }
+
+  // Erase by index. Returns true if the element was live.
+  bool erase(std::size_t idx)
+  {
+    // Decides which erase wins. The list's pin keeps the slot, and so its
+    // link, from being reused until it is unlinked, which needs our mark.
+    if (!items.erase(idx))
+    {
+      return false;
+    }
+
+    std::uint64_t own = links[idx].fetch_or(MARK_BIT, std::memory_order_acq_rel);
+    live.fetch_sub(1, std::memory_order_relaxed);
+
+    // A pending slot is unlinked by its inserter once linked
+    if (!is_pending(own))
+    {
+      unlink(idx);
+    }
+
+    return true;
+  }
+
+  // Access by index
+  std::optional<Op_Result> at(std::size_t idx) const
+  {
+    return items.at(idx);
+  }
+
+  // Find the first live element matching the predicate, in insertion
+  // order (O(live)). Like at(), the reference is not pinned.
+  template<typename Predicate>
+  std::optional<Op_Result> find_if(Predicate pred) const
+  {
+    std::optional<Op_Result> found;
+
+    walk([&](std::size_t i, T& value)
+    {
+      if (pred(value))
+      {
+        found.emplace(Op_Result{ i, value });
+        return false;
+      }
+
+      return true;
+    });
+
+    return found;
+  }
+
+  // Number of live elements (O(1), approximate under concurrent writes)
+  std::size_t size() const
+  {
+    return live.load(std::memory_order_relaxed);
+  }
+
+  constexpr std::size_t capacity() const
+  {
+    return Capacity;
+  }
+
+  // Call f(index, value) for every live element, in insertion order
+  // (O(live)). Each element is pinned while f runs.
+  template<typename Func>
+  void for_each_live(Func f) const
+  {
+    walk([&](std::size_t i, T& value)
+    {
+      f(i, value);
+      return true;
+    });
+  }
+
+  // Call f(index, value) for every live element, in slot order
+  // (O(Capacity)).
+  template<typename Func>
+  void for_each(Func f) const
+  {
+    for (std::size_t i = 0; i < Capacity; ++i)
+    {
+      if (auto r = at(i))
+      {
+        f(r->index, r->value);
+      }
+    }
+  }
+
+  Safe_Live_Array()
+  {
+    for (auto& link : links)
+    {
+      link.store(PENDING_BIT | INVALID_INDEX, std::memory_order_relaxed);
+    }
+  }
+};
+
+#endif // LOCKFREE_THREADSAFE_LIVE_ARRAY
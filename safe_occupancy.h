@@ -0,0 +1,262 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+#ifndef LOCKFREE_THREADSAFE_OCCUPANCY
+#define LOCKFREE_THREADSAFE_OCCUPANCY
+
+#include "safe_array.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <random>
+
+// Occupancy summary for Safe_Array: pass it as the Feed parameter
+// (Safe_Array<T, N, Safe_Occupancy<N>>) and the array can hand out
+// uniformly random live elements with sample() / sample_k(), in time that
+// depends on the capacity only logarithmically (base 64) and not at all on
+// how sparse the array is. It takes the array's only Feed parameter, so
+// an array with sample() cannot also have a Safe_Change_Feed.
+//
+// One bit per slot, under a tree of live counts with fan-out 64 (a count
+// per 4096 slots, per 262144, ...). A pick draws r < live and walks down the
+// counts to the r-th set bit. The bit is set when an insert claims the slot,
+// before the element is visible, and cleared when the slot goes back to the
+// free list, not when it is erased: the inserter and the thread freeing the
+// slot own it at the time, so the two can never land out of order. Every
+// live slot's bit is set; a set bit may also mark a slot still being built,
+// or erased but pinned by a Guard until that Guard is released. sample()
+// rejects those by checking the slot and drawing again.
+template<std::size_t Capacity>
+class Safe_Occupancy
+{
+  static_assert(Capacity > 0 && Capacity < 0xFFFFFFFFULL,
+    "Capacity must fit in 32 bits");
+
+public:
+  static constexpr std::size_t MAX_SLOTS = Capacity;
+  static constexpr std::size_t NONE = ~std::size_t(0);
+
+private:
+  static constexpr std::size_t FAN = 64;
+  static constexpr std::size_t WORDS = (Capacity + FAN - 1) / FAN;
+
+  // Nodes on `level`: level 0 = bitmap words, level l = counts over FAN^l words
+  static constexpr std::size_t width(std::size_t level)
+  {
+    std::size_t n = WORDS;
+
+    for (std::size_t l = 0; l < level; ++l)
+    {
+      n = (n + FAN - 1) / FAN;
+    }
+
+    return n;
+  }
+
+  // Lowest level with at most FAN nodes; a pick sums it to get the total
+  static constexpr std::size_t top_level()
+  {
+    std::size_t l = 0;
+
+    while (width(l) > FAN)
+    {
+      ++l;
+    }
+
+    return l;
+  }
+
+  static constexpr std::size_t TOP = top_level();
+
+  // Start of level l (1..TOP) in `counts`
+  static constexpr std::size_t offset(std::size_t level)
+  {
+    std::size_t o = 0;
+
+    for (std::size_t l = 1; l < level; ++l)
+    {
+      o += width(l);
+    }
+
+    return o;
+  }
+
+  static constexpr std::size_t COUNTS = TOP ? offset(TOP + 1) : 1;
+
+  std::array<std::atomic<std::uint64_t>, WORDS> bits{};
+
+  // Signed, and clamped when read: a walk may see one level of an update
+  // before another
+  std::array<std::atomic<std::int64_t>, COUNTS> counts{};
+
+  // Live slots under node `node` of `level` (clamped at 0 while in flux)
+  std::uint64_t weight(std::size_t level, std::size_t node) const
+  {
+    if (level == 0)
+    {
+      return popcount(bits[node].load(std::memory_order_relaxed));
+    }
+
+    std::int64_t n = counts[offset(level) + node].load(std::memory_order_relaxed);
+    return n > 0 ? std::uint64_t(n) : 0;
+  }
+
+  static std::uint64_t popcount(std::uint64_t v)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return std::uint64_t(__builtin_popcountll(v));
+#else
+    std::uint64_t n = 0;
+
+    for (; v; v &= v - 1)
+    {
+      ++n;
+    }
+
+    return n;
+#endif
+  }
+
+  void count(std::size_t word, std::int64_t delta)
+  {
+    for (std::size_t l = 1, node = word / FAN; l <= TOP; ++l, node /= FAN)
+    {
+      counts[offset(l) + node].fetch_add(delta, std::memory_order_relaxed);
+    }
+  }
+
+public:
+  // Keep the bits in step with the array's slots. Called by Safe_Array.
+  void claimed(std::size_t index)
+  {
+    std::size_t w = index / FAN;
+    std::uint64_t mask = std::uint64_t(1) << (index % FAN);
+
+    if (!(bits[w].fetch_or(mask, std::memory_order_acq_rel) & mask))
+    {
+      count(w, 1);
+    }
+  }
+
+  // Also called for replace's shadow slots, whose bits were never set
+  void freed(std::size_t index)
+  {
+    std::size_t w = index / FAN;
+    std::uint64_t mask = std::uint64_t(1) << (index % FAN);
+
+    if (bits[w].fetch_and(~mask, std::memory_order_acq_rel) & mask)
+    {
+      count(w, -1);
+    }
+  }
+
+  // Changes themselves are not needed: the bits follow claimed() / freed()
+  void publish(Safe_Change_Op, std::size_t, Safe_Slot::Word)
+  {
+  }
+
+  // Number of slots marked live (exact when no write is in flight)
+  std::size_t live() const
+  {
+    std::uint64_t total = 0;
+
+    for (std::size_t j = 0; j < width(TOP); ++j)
+    {
+      if constexpr (TOP == 0)
+      {
+        total += popcount(bits[j].load(std::memory_order_relaxed));
+      }
+      else
+      {
+        std::int64_t n = counts[offset(TOP) + j].load(std::memory_order_relaxed);
+        total += n > 0 ? std::uint64_t(n) : 0;
+      }
+    }
+
+    return std::size_t(total);
+  }
+
+  // A uniformly chosen slot among those marked live, or NONE if there are
+  // none (or the summary kept changing under the walk; draw again)
+  template<typename Rng>
+  std::size_t pick(Rng& rng) const
+  {
+    std::uint64_t total = live();
+
+    if (total == 0)
+    {
+      return NONE;
+    }
+
+    std::uint64_t r = std::uniform_int_distribution<std::uint64_t>(0, total - 1)(rng);
+    std::size_t node = 0;
+
+    // Descend from the top: at each level, find the child holding the r-th
+    // live slot of its parent
+    for (std::size_t l = TOP + 1; l-- > 0;)
+    {
+      std::size_t first = l == TOP ? 0 : node * FAN;
+      std::size_t last = l == TOP ? width(TOP) : std::min(first + FAN, width(l));
+      std::size_t child = last;
+
+      for (std::size_t j = first; j < last; ++j)
+      {
+        std::uint64_t w = weight(l, j);
+
+        if (r < w)
+        {
+          child = j;
+          break;
+        }
+
+        r -= w;
+      }
+
+      if (child == last)
+      {
+        return NONE; // Counts moved under us
+      }
+
+      node = child;
+    }
+
+    // The r-th set bit of word `node`
+    std::uint64_t v = bits[node].load(std::memory_order_acquire);
+
+    for (; r > 0 && v; --r)
+    {
+      v &= v - 1;
+    }
+
+    if (!v)
+    {
+      return NONE;
+    }
+
+    std::size_t bit = 0;
+
+    while (!(v & 1))
+    {
+      v >>= 1;
+      ++bit;
+    }
+
+    return node * FAN + bit;
+  }
+
+  constexpr std::size_t capacity() const
+  {
+    return Capacity;
+  }
+
+  constexpr Safe_Occupancy()
+  {
+  }
+};
+
+#endif // LOCKFREE_THREADSAFE_OCCUPANCY
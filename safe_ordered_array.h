@@ -0,0 +1,701 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+#ifndef LOCKFREE_THREADSAFE_ORDERED_ARRAY
+#define LOCKFREE_THREADSAFE_ORDERED_ARRAY
+
+#include "safe_array.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Default Key_Of: the element is its own key
+struct Safe_Key_Identity
+{
+  template<typename U>
+  const U& operator()(const U& value) const
+  {
+    return value;
+  }
+};
+
+// Safe_Array with a lock-free ordered index: a skiplist threaded through the
+// slots by index (no copies of T or of the key), maintained by insert and
+// erase. Elements are ordered by (key_of(value), slot index), so equal keys
+// are allowed. Supports lower_bound, range queries and ordered iteration.
+//
+// Each level is a Harris list with versioned index links, as in
+// Safe_Hash_Map. A slot goes back to the array only once it is unlinked from
+// every level it was linked at, so a reachable index is never reused.
+template<typename T, std::size_t Capacity,
+  typename Key_Of = Safe_Key_Identity, typename Compare = std::less<>>
+class Safe_Ordered_Array
+{
+  static_assert(Capacity < 0xFFFFFFFFULL,
+    "Capacity must fit in 32 bits");
+
+public:
+  using Op_Result = typename Safe_Array<T, Capacity>::Op_Result;
+  using Key = std::decay_t<std::invoke_result_t<const Key_Of&, const T&>>;
+  using Guard = typename Safe_Array<T, Capacity>::Guard;
+
+private:
+  // Tower heights are geometric with p = 1/4, so about log4(Capacity)
+  // levels keep searches O(log n)
+  static constexpr std::size_t levels_for(std::size_t n)
+  {
+    std::size_t levels = 1;
+
+    while (n > 4 && levels < 16)
+    {
+      n >>= 2;
+      ++levels;
+    }
+
+    return levels;
+  }
+
+  static constexpr std::size_t LEVELS = levels_for(Capacity);
+  static constexpr std::size_t INVALID_INDEX = Capacity;
+
+  // Link word: low 32 bits = slot index; bit 32 = deletion mark;
+  // upper bits = version, bumped on every write to defeat ABA on slot reuse.
+  static constexpr std::uint64_t INDEX_MASK = 0xFFFFFFFFULL;
+  static constexpr std::uint64_t MARK_BIT = 1ULL << 32;
+  static constexpr std::uint64_t VERSION_STEP = 1ULL << 33;
+
+  using Tower = std::array<std::atomic<std::uint64_t>, LEVELS>;
+
+  Safe_Array<T, Capacity> items;
+  Tower head{};
+  std::array<Tower, Capacity> towers{};
+
+  // Levels a node is linked at, plus one while its inserter is still
+  // linking it. The slot is freed when this drops to zero.
+  std::array<std::atomic<std::uint32_t>, Capacity> linked{};
+
+  Key_Of key_of;
+  Compare less;
+
+  static std::size_t index_of(std::uint64_t link)
+  {
+    return std::size_t(link & INDEX_MASK);
+  }
+
+  static bool is_marked(std::uint64_t link)
+  {
+    return (link & MARK_BIT) != 0;
+  }
+
+  // Next version of `link` pointing at `idx`
+  static std::uint64_t relink(std::uint64_t link, std::size_t idx)
+  {
+    std::uint64_t version = (link & ~(INDEX_MASK | MARK_BIT)) + VERSION_STEP;
+    return version | std::uint64_t(idx);
+  }
+
+  // 1 + number of extra levels, P(h) = 4^-(h-1)
+  static std::size_t random_height()
+  {
+    static thread_local std::uint32_t seed = std::uint32_t(
+      reinterpret_cast<std::uintptr_t>(&seed)) | 1;
+
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    std::size_t height = 1;
+
+    for (std::uint32_t bits = seed; height < LEVELS && (bits & 3) == 0; bits >>= 2)
+    {
+      ++height;
+    }
+
+    return height;
+  }
+
+  const std::atomic<std::uint64_t>& link_at(std::size_t node, std::size_t level) const
+  {
+    return node == INVALID_INDEX ? head[level] : towers[node][level];
+  }
+
+  std::atomic<std::uint64_t>& link_at(std::size_t node, std::size_t level)
+  {
+    return node == INVALID_INDEX ? head[level] : towers[node][level];
+  }
+
+  // True if element `node` holding `value` sorts before (key, idx)
+  template<typename K>
+  bool before(std::size_t node, const T& value, const K& key, std::size_t idx) const
+  {
+    const auto& k = key_of(value);
+
+    if (less(k, key))
+    {
+      return true;
+    }
+
+    return !less(key, k) && node < idx;
+  }
+
+  // One level fewer links `idx`; the last one out returns it to the array
+  void unlinked(std::size_t idx)
+  {
+    if (linked[idx].fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      items.erase(idx);
+    }
+  }
+
+  // Check a descent from `prev` to `level`: the link read there must not
+  // be marked (an erase froze it), and prev's link one level up must be
+  // unchanged, or prev may have been erased and its slot reused elsewhere.
+  bool descended(std::size_t prev, std::size_t level,
+    std::uint64_t link, std::uint64_t above) const
+  {
+    if (is_marked(link))
+    {
+      return false;
+    }
+
+    return prev == INVALID_INDEX ||
+      towers[prev][level + 1].load(std::memory_order_acquire) == above;
+  }
+
+  struct Position
+  {
+    std::array<std::size_t, LEVELS> prev;
+    std::array<std::uint64_t, LEVELS> prev_link;
+  };
+
+  // Locate the predecessors of (key, idx) on every level, unlinking marked
+  // nodes on the way. Every node is pinned and its predecessor link
+  // re-read before its key is compared, so a recycled slot forces a
+  // restart and an erased one stays alive until the comparison is done.
+  template<typename K>
+  void locate(const K& key, std::size_t idx, Position& pos)
+  {
+  retry:
+    std::size_t prev = INVALID_INDEX;
+    std::uint64_t above = 0;
+
+    for (std::size_t level = LEVELS; level-- > 0;)
+    {
+      std::atomic<std::uint64_t>* link = &link_at(prev, level);
+      std::uint64_t prev_link = link->load(std::memory_order_acquire);
+
+      if (!descended(prev, level, prev_link, above))
+      {
+        goto retry;
+      }
+
+      for (;;)
+      {
+        std::size_t curr = index_of(prev_link);
+
+        if (curr == INVALID_INDEX)
+        {
+          break;
+        }
+
+        std::uint64_t curr_link = towers[curr][level].load(std::memory_order_acquire);
+        std::optional<Guard> node;
+
+        // Pin before reading the key (a marked node is never compared),
+        // then check the link still leads here, so it is not recycled
+        if (!is_marked(curr_link))
+        {
+          node = items.acquire(curr);
+        }
+
+        if ((!node && !is_marked(curr_link)) ||
+          link->load(std::memory_order_acquire) != prev_link)
+        {
+          goto retry;
+        }
+
+        bool ahead = node && before(curr, **node, key, idx);
+
+        if (is_marked(curr_link))
+        {
+          std::uint64_t next_link = relink(prev_link, index_of(curr_link));
+
+          if (!link->compare_exchange_strong(
+            prev_link, next_link,
+            std::memory_order_acq_rel,
+            std::memory_order_relaxed))
+          {
+            goto retry;
+          }
+
+          unlinked(curr);
+          prev_link = next_link;
+          continue;
+        }
+
+        if (!ahead)
+        {
+          break;
+        }
+
+        prev = curr;
+        link = &towers[curr][level];
+        prev_link = curr_link;
+      }
+
+      pos.prev[level] = prev;
+      pos.prev_link[level] = prev_link;
+      above = prev_link;
+    }
+  }
+
+  // Read-only position on level 0. Marked nodes are passed over rather
+  // than unlinked, and a marked node's link is frozen, so reads are
+  // validated against the anchor: the last link followed that was not
+  // marked. While it is unchanged, every node after it up to `prev` is
+  // still in the list and cannot have been recycled.
+  struct Cursor
+  {
+    std::size_t prev;
+    std::uint64_t prev_link;
+    std::size_t anchor;
+    std::uint64_t anchor_link;
+
+    void advance(std::size_t curr, std::uint64_t curr_link)
+    {
+      prev = curr;
+      prev_link = curr_link;
+
+      if (!is_marked(curr_link))
+      {
+        anchor = curr;
+        anchor_link = curr_link;
+      }
+    }
+  };
+
+  bool valid(const Cursor& at) const
+  {
+    return link_at(at.anchor, 0).load(std::memory_order_acquire) == at.anchor_link;
+  }
+
+  Cursor first() const
+  {
+    std::uint64_t link = head[0].load(std::memory_order_acquire);
+    return { INVALID_INDEX, link, INVALID_INDEX, link };
+  }
+
+  // Descend to the last level-0 node before (key, idx). Upper levels only
+  // step onto unmarked nodes, so every descent starts from a live link.
+  template<typename K>
+  Cursor seek(const K& key, std::size_t idx) const
+  {
+  retry:
+    std::size_t prev = INVALID_INDEX;
+    std::uint64_t above = 0;
+
+    for (std::size_t level = LEVELS; level-- > 1;)
+    {
+      const std::atomic<std::uint64_t>* link = &link_at(prev, level);
+      std::uint64_t prev_link = link->load(std::memory_order_acquire);
+
+      if (!descended(prev, level, prev_link, above))
+      {
+        goto retry;
+      }
+
+      for (;;)
+      {
+        std::size_t curr = index_of(prev_link);
+
+        if (curr == INVALID_INDEX)
+        {
+          break;
+        }
+
+        std::uint64_t curr_link = towers[curr][level].load(std::memory_order_acquire);
+        std::optional<Guard> node;
+
+        // Pin before reading the key (a marked node is never compared),
+        // then check the link still leads here, so it is not recycled
+        if (!is_marked(curr_link))
+        {
+          node = items.acquire(curr);
+        }
+
+        if ((!node && !is_marked(curr_link)) ||
+          link->load(std::memory_order_acquire) != prev_link)
+        {
+          goto retry;
+        }
+
+        bool ahead = node && before(curr, **node, key, idx);
+
+        if (!ahead)
+        {
+          break;
+        }
+
+        prev = curr;
+        link = &towers[curr][level];
+        prev_link = curr_link;
+      }
+
+      above = prev_link;
+    }
+
+    std::uint64_t prev_link = link_at(prev, 0).load(std::memory_order_acquire);
+
+    if (!descended(prev, 0, prev_link, above))
+    {
+      goto retry;
+    }
+
+    Cursor at{ prev, prev_link, prev, prev_link };
+
+    for (;;)
+    {
+      std::size_t curr = index_of(at.prev_link);
+
+      if (curr == INVALID_INDEX)
+      {
+        return at;
+      }
+
+      std::uint64_t curr_link = towers[curr][0].load(std::memory_order_acquire);
+      auto node = items.acquire(curr);
+
+      if (!node || !valid(at))
+      {
+        goto retry;
+      }
+
+      bool ahead = before(curr, **node, key, idx);
+
+      if (!ahead)
+      {
+        return at;
+      }
+
+      at.advance(curr, curr_link);
+    }
+  }
+
+  // Visit live elements in order from (*key, idx), or from the start if
+  // key is null, while visit(index, value) returns true. Each element is
+  // pinned while visited. A node recycled under the walk restarts it just
+  // past the last element visited; that element's key is copied for this
+  // purpose once the walk moves past it.
+  template<typename K, typename Visit>
+  void walk(const K* key, std::size_t idx, Visit visit) const
+  {
+    std::optional<Key> last;
+    std::size_t last_idx = 0;
+
+    auto restart = [&]
+    {
+      if (last)
+      {
+        return seek(*last, last_idx + 1);
+      }
+
+      return key ? seek(*key, idx) : first();
+    };
+
+    Cursor at = restart();
+
+    for (;;)
+    {
+      std::size_t curr = index_of(at.prev_link);
+
+      if (curr == INVALID_INDEX)
+      {
+        return;
+      }
+
+      std::uint64_t curr_link = towers[curr][0].load(std::memory_order_acquire);
+
+      if (!valid(at))
+      {
+        at = restart();
+        continue;
+      }
+
+      if (!is_marked(curr_link))
+      {
+        // Pin before visiting, then check the node is still the one in the
+        // list; the pin keeps it from being recycled while f runs
+        auto node = items.acquire(curr);
+
+        if (!node || !valid(at))
+        {
+          at = restart();
+          continue;
+        }
+
+        if (!visit(curr, **node))
+        {
+          return;
+        }
+
+        last = key_of(**node); // Only needed to go on (still pinned)
+        last_idx = curr;
+      }
+
+      at.advance(curr, curr_link);
+    }
+  }
+
+public:
+  // Insert an element and link it into the index.
+  // Returns {index, reference} or nullopt if full.
+  template<typename... Args>
+  std::optional<Op_Result> insert(Args&&... args)
+  {
+    // Reset the tower before the element is published, so an erase that
+    // sees it live finds no stale marks and its own marks are kept. The
+    // Guard keeps the key readable while the element is linked.
+    auto node = items.insert_pinned_prepared([&](std::size_t idx, const T&, Safe_Slot::Word)
+    {
+      linked[idx].store(1, std::memory_order_relaxed); // The inserter's hold
+
+      // Clear marks left from the slot's previous element
+      for (auto& link : towers[idx])
+      {
+        link.store(relink(link.load(std::memory_order_relaxed), INVALID_INDEX),
+          std::memory_order_relaxed);
+      }
+    }, std::forward<Args>(args)...);
+
+    if (!node)
+    {
+      return std::nullopt;
+    }
+
+    std::size_t idx = node->index();
+    std::size_t height = random_height();
+    const auto& key = key_of(**node);
+    Position pos;
+
+    for (std::size_t level = 0; level < height; ++level)
+    {
+      for (;;)
+      {
+        locate(key, idx, pos);
+
+        // Point our own link at the successor, unless an erase marked it
+        std::uint64_t own = towers[idx][level].load(std::memory_order_acquire);
+
+        if (is_marked(own))
+        {
+          goto done;
+        }
+
+        if (!towers[idx][level].compare_exchange_strong(
+          own, relink(own, index_of(pos.prev_link[level])),
+          std::memory_order_acq_rel,
+          std::memory_order_relaxed))
+        {
+          continue;
+        }
+
+        linked[idx].fetch_add(1, std::memory_order_relaxed);
+
+        if (link_at(pos.prev[level], level).compare_exchange_strong(
+          pos.prev_link[level], relink(pos.prev_link[level], idx),
+          std::memory_order_acq_rel,
+          std::memory_order_relaxed))
+        {
+          break;
+        }
+
+        linked[idx].fetch_sub(1, std::memory_order_relaxed);
+      }
+    }
+
+  done:
+    // Erased while linking: make sure no level still reaches it
+    if (is_marked(towers[idx][0].load(std::memory_order_acquire)))
+    {
+      locate(key, idx, pos);
+    }
+
+    unlinked(idx);
+    return Op_Result{ idx, **node };
+  }
+
+  // Erase by index: mark every level (level 0 last; that mark is the
+  // logical delete), then unlink. Returns true if the element was live.
+  bool erase(std::size_t idx)
+  {
+    // Pinned so the key stays readable after the node is unlinked
+    auto node = items.acquire(idx);
+
+    if (!node)
+    {
+      return false;
+    }
+
+    for (std::size_t level = LEVELS; level-- > 1;)
+    {
+      std::uint64_t own = towers[idx][level].load(std::memory_order_acquire);
+
+      while (!is_marked(own) && !towers[idx][level].compare_exchange_weak(
+        own, own | MARK_BIT,
+        std::memory_order_acq_rel,
+        std::memory_order_acquire))
+      {
+      }
+    }
+
+    std::uint64_t own = towers[idx][0].load(std::memory_order_acquire);
+
+    do
+    {
+      if (is_marked(own))
+      {
+        return false; // Another erase won
+      }
+    } while (!towers[idx][0].compare_exchange_weak(
+      own, own | MARK_BIT,
+      std::memory_order_acq_rel,
+      std::memory_order_acquire));
+
+    Position pos;
+    locate(key_of(**node), idx, pos);
+    return true;
+  }
+
+  // Access by index; logically erased elements read as absent
+  std::optional<Op_Result> at(std::size_t idx) const
+  {
+    auto r = items.at(idx);
+
+    if (!r || is_marked(towers[idx][0].load(std::memory_order_acquire)))
+    {
+      return std::nullopt;
+    }
+
+    return r;
+  }
+
+  // First element whose key is not less than `key`. Like at(), the
+  // reference is not pinned.
+  template<typename K>
+  std::optional<Op_Result> lower_bound(const K& key) const
+  {
+    std::optional<Op_Result> found;
+
+    walk(&key, 0, [&](std::size_t i, T& value)
+    {
+      found.emplace(Op_Result{ i, value });
+      return false;
+    });
+
+    return found;
+  }
+
+  // First element whose key is equivalent to `key`, found through the
+  // index. `key` may be any type Compare accepts against the extracted
+  // key, so no T (or key) is built for the lookup. Not pinned, like at().
+  template<typename K>
+  std::optional<Op_Result> find(const K& key) const
+  {
+    auto r = lower_bound(key);
+
+    if (r && less(key, key_of(r->value)))
+    {
+      return std::nullopt;
+    }
+
+    return r;
+  }
+
+  // Call f(index, value) for every element with key in [first, last), in
+  // key order
+  template<typename K, typename Func>
+  void range(const K& first, const K& last, Func f) const
+  {
+    walk(&first, 0, [&](std::size_t i, T& value)
+    {
+      if (!less(key_of(value), last))
+      {
+        return false;
+      }
+
+      f(i, value);
+      return true;
+    });
+  }
+
+  // Call f(index, value) for every element in key order
+  template<typename Func>
+  void for_each_ordered(Func f) const
+  {
+    walk(static_cast<const Key*>(nullptr), 0, [&](std::size_t i, T& value)
+    {
+      f(i, value);
+      return true;
+    });
+  }
+
+  // Find the first live element matching the predicate (slot order)
+  template<typename Predicate>
+  std::optional<Op_Result> find_if(Predicate pred) const
+  {
+    for (std::size_t i = 0; i < Capacity; ++i)
+    {
+      auto r = at(i);
+
+      if (r && pred(r->value))
+      {
+        return r;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  // Number of slots in use, including erased elements still being
+  // unlinked (O(Capacity))
+  std::size_t size() const
+  {
+    return items.size();
+  }
+
+  constexpr std::size_t capacity() const
+  {
+    return Capacity;
+  }
+
+  // Call f(index, value) for every live element, in slot order.
+  template<typename Func>
+  void for_each(Func f) const
+  {
+    for (std::size_t i = 0; i < Capacity; ++i)
+    {
+      if (auto r = at(i))
+      {
+        f(r->index, r->value);
+      }
+    }
+  }
+
+  Safe_Ordered_Array()
+  {
+    for (auto& link : head)
+    {
+      link.store(INVALID_INDEX, std::memory_order_relaxed);
+    }
+  }
+};
+
+#endif // LOCKFREE_THREADSAFE_ORDERED_ARRAY
@@ -0,0 +1,236 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+#ifndef LOCKFREE_THREADSAFE_QUEUE
+#define LOCKFREE_THREADSAFE_QUEUE
+
+#include "safe_array.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <new>
+#include <utility>
+
+// Bounded MPMC FIFO queue (Vyukov-style) over the Safe_Array slot state
+// machine. The slot generation doubles as the lap number: a cell is free for
+// ticket `pos` when it is EMPTY with generation pos / Capacity, and holds the
+// element for `pos` when it is READY with that generation.
+template<typename T, std::size_t Capacity>
+class Safe_Queue
+{
+  static_assert(std::is_nothrow_destructible<T>::value,
+    "T must be nothrow destructible");
+  static_assert(Capacity > 0, "Capacity must be non-zero");
+
+private:
+  using Word = Safe_Slot::Word;
+
+  struct Cell : Safe_Slot
+  {
+    std::atomic<Word> state{ EMPTY };
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  std::array<Cell, Capacity> cells;
+  alignas(64) std::atomic<std::uint64_t> tail{ 0 };
+  alignas(64) std::atomic<std::uint64_t> head{ 0 };
+
+  Cell& cell_at(std::uint64_t pos)
+  {
+    return cells[std::size_t(pos % Capacity)];
+  }
+
+  static Word expected(std::uint64_t pos, Word state)
+  {
+    return Safe_Slot::make(Word(pos / Capacity), state);
+  }
+
+  // Claim up to `max` consecutive tickets from `ticket` whose cells are in
+  // `state` for their lap. Returns the first ticket and sets `count`; count is
+  // zero when the queue is full (enqueue) or empty (dequeue).
+  std::uint64_t claim(std::atomic<std::uint64_t>& ticket, Word state,
+    std::size_t max, std::size_t& count)
+  {
+    std::uint64_t pos = ticket.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+      std::size_t n = 0;
+      bool behind = false;
+
+      while (n < max && n < Capacity)
+      {
+        Word st = cell_at(pos + n).state.load(std::memory_order_acquire);
+        auto diff = Safe_Slot::distance(st, expected(pos + n, state));
+
+        if (diff != 0)
+        {
+          behind = n == 0 && diff > 0;
+          break;
+        }
+
+        ++n;
+      }
+
+      if (n == 0)
+      {
+        if (!behind)
+        {
+          count = 0;
+          return pos;
+        }
+
+        // Another thread took this ticket; catch up
+        pos = ticket.load(std::memory_order_relaxed);
+        continue;
+      }
+
+      if (ticket.compare_exchange_weak(
+        pos, pos + n,
+        std::memory_order_relaxed,
+        std::memory_order_relaxed))
+      {
+        count = n;
+        return pos;
+      }
+    }
+  }
+
+  template<typename... Args>
+  void fill(std::uint64_t pos, Args&&... args)
+  {
+    Cell& c = cell_at(pos);
+    Word init_st = expected(pos, Cell::INIT);
+    c.state.store(init_st, std::memory_order_relaxed);
+
+    T* ptr = reinterpret_cast<T*>(&c.storage);
+    ::new (ptr) T(std::forward<Args>(args)...);
+
+    // Same generation: READY belongs to the lap that produced it
+    c.state.store(Safe_Slot::counter_of(init_st) | Cell::READY, std::memory_order_release);
+  }
+
+  template<typename Func>
+  void drain(std::uint64_t pos, Func&& f)
+  {
+    Cell& c = cell_at(pos);
+    Word rem_st = expected(pos, Cell::REMOVING);
+    c.state.store(rem_st, std::memory_order_relaxed);
+
+    T* ptr = reinterpret_cast<T*>(&c.storage);
+    f(std::move(*ptr));
+    ptr->~T();
+
+    // Next lap: bump counter, mark EMPTY
+    c.state.store(Safe_Slot::bump(rem_st, Cell::EMPTY), std::memory_order_release);
+  }
+
+public:
+  // Construct T(args...) in place at the tail. Returns false if full.
+  template<typename... Args>
+  bool enqueue(Args&&... args)
+  {
+    std::size_t n;
+    std::uint64_t pos = claim(tail, Cell::EMPTY, 1, n);
+
+    if (n == 0)
+    {
+      return false;
+    }
+
+    fill(pos, std::forward<Args>(args)...);
+    return true;
+  }
+
+  // Pop the head element. Returns nullopt if empty.
+  std::optional<T> dequeue()
+  {
+    std::size_t n;
+    std::uint64_t pos = claim(head, Cell::READY, 1, n);
+
+    if (n == 0)
+    {
+      return std::nullopt;
+    }
+
+    std::optional<T> out;
+    drain(pos, [&](T&& v)
+    {
+      out.emplace(std::move(v));
+    });
+
+    return out;
+  }
+
+  // Enqueue up to `count` elements copied/moved from `first` with a single
+  // ticket claim. Returns the number enqueued.
+  template<typename Iterator>
+  std::size_t enqueue_bulk(Iterator first, std::size_t count)
+  {
+    std::size_t n;
+    std::uint64_t pos = claim(tail, Cell::EMPTY, count, n);
+
+    for (std::size_t i = 0; i < n; ++i, ++first)
+    {
+      fill(pos + i, *first);
+    }
+
+    return n;
+  }
+
+  // Dequeue up to `max` elements into `out` with a single ticket claim.
+  // Returns the number dequeued.
+  template<typename Output_Iterator>
+  std::size_t dequeue_bulk(Output_Iterator out, std::size_t max)
+  {
+    std::size_t n;
+    std::uint64_t pos = claim(head, Cell::READY, max, n);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      drain(pos + i, [&](T&& v)
+      {
+        *out = std::move(v);
+        ++out;
+      });
+    }
+
+    return n;
+  }
+
+  // Approximate number of queued elements
+  std::size_t size() const
+  {
+    std::uint64_t t = tail.load(std::memory_order_relaxed);
+    std::uint64_t h = head.load(std::memory_order_relaxed);
+    return t > h ? std::size_t(t - h) : 0;
+  }
+
+  constexpr std::size_t capacity() const
+  {
+    return Capacity;
+  }
+
+  Safe_Queue() = default;
+
+  ~Safe_Queue()
+  {
+    for (std::size_t i = 0; i < Capacity; ++i)
+    {
+      Word st = cells[i].state.load(std::memory_order_acquire);
+
+      if (Safe_Slot::state_of(st) == Cell::READY)
+      {
+        reinterpret_cast<T*>(&cells[i].storage)->~T();
+      }
+    }
+  }
+};
+
+#endif // LOCKFREE_THREADSAFE_QUEUE
@@ -0,0 +1,244 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+#ifndef LOCKFREE_THREADSAFE_SPLIT_ARRAY
+#define LOCKFREE_THREADSAFE_SPLIT_ARRAY
+
+#include "safe_array.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Safe_Array with a hot/cold split: Hot_Of projects the few fields scans
+// look at (a key, a status) out of a large T, and a copy of that projection
+// is kept in a dense column indexed by slot. find_if_hot and for_each_hot
+// stride through the column only; the element itself (and its slot's
+// state word, which shares a cache line with it) is touched only on a match.
+//
+// Each hot cell is a seqlock: a tag (slot generation + 1, 0 while unset or
+// being written) around the projection stored as relaxed atomic words. The
+// cell is written while its slot is still INIT (insert_prepared), so only
+// the slot's owner ever writes it, and cleared by the erase that wins the
+// slot.
+template<typename T, std::size_t Capacity, typename Hot_Of>
+class Safe_Split_Array
+{
+public:
+  using Op_Result = typename Safe_Array<T, Capacity>::Op_Result;
+  using Hot = std::decay_t<std::invoke_result_t<const Hot_Of&, const T&>>;
+
+  static_assert(std::is_trivially_copyable<Hot>::value &&
+    std::is_default_constructible<Hot>::value,
+    "The hot projection must be trivially copyable and default constructible");
+
+private:
+  static constexpr std::size_t WORDS = (sizeof(Hot) + 7) / 8;
+
+  struct Hot_Cell
+  {
+    std::atomic<std::uint64_t> tag{ 0 };
+    std::array<std::atomic<std::uint64_t>, WORDS> words{};
+  };
+
+  Safe_Array<T, Capacity> items;
+  std::array<Hot_Cell, Capacity> hot{};
+  Hot_Of hot_of;
+
+  // Record the projection of `value` for the element that slot `idx` will
+  // hold at `generation`. Caller owns the slot (it is not published yet).
+  void write_hot(std::size_t idx, const T& value, Safe_Slot::Word generation)
+  {
+    Hot_Cell& cell = hot[idx];
+    std::array<std::uint64_t, WORDS> buf{};
+    Hot h = hot_of(value);
+    std::memcpy(buf.data(), &h, sizeof(Hot));
+
+    cell.tag.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (std::size_t w = 0; w < WORDS; ++w)
+    {
+      cell.words[w].store(buf[w], std::memory_order_relaxed);
+    }
+
+    cell.tag.store(generation + 1, std::memory_order_release);
+  }
+
+  // Consistent copy of cell `idx`; returns its tag, 0 if unset or torn
+  std::uint64_t read_hot(std::size_t idx, Hot& out) const
+  {
+    const Hot_Cell& cell = hot[idx];
+    std::uint64_t tag = cell.tag.load(std::memory_order_acquire);
+
+    if (tag == 0)
+    {
+      return 0;
+    }
+
+    std::array<std::uint64_t, WORDS> buf;
+
+    for (std::size_t w = 0; w < WORDS; ++w)
+    {
+      buf[w] = cell.words[w].load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (cell.tag.load(std::memory_order_relaxed) != tag)
+    {
+      return 0;
+    }
+
+    std::memcpy(&out, buf.data(), sizeof(Hot));
+    return tag;
+  }
+
+  // The element at `idx` if it is live at generation tag - 1
+  std::optional<Op_Result> confirm(std::size_t idx, std::uint64_t tag) const
+  {
+    auto r = items.at(idx);
+
+    if (!r || items.generation(idx) + 1 != tag)
+    {
+      return std::nullopt;
+    }
+
+    return r;
+  }
+
+public:
+  // Insert T(args...): built invisibly, its hot projection recorded, then
+  // published. Returns {index, reference} or nullopt if full.
+  template<typename... Args>
+  std::optional<Op_Result> insert(Args&&... args)
+  {
+    return items.insert_prepared([&](std::size_t idx, const T& value, Safe_Slot::Word generation)
+    {
+      write_hot(idx, value, generation);
+    }, std::forward<Args>(args)...);
+  }
+
+  // Erase by index. Returns true if the slot was live.
+  bool erase(std::size_t idx)
+  {
+    if (idx >= Capacity)
+    {
+      return false;
+    }
+
+    for (;;)
+    {
+      Safe_Slot::Word generation = items.generation(idx);
+
+      if (items.erase(idx, generation))
+      {
+        // Only if no later insert has taken over the cell yet
+        std::uint64_t tag = generation + 1;
+        hot[idx].tag.compare_exchange_strong(tag, 0,
+          std::memory_order_acq_rel,
+          std::memory_order_relaxed);
+        return true;
+      }
+
+      if (!items.at(idx))
+      {
+        return false;
+      }
+    }
+  }
+
+  // Copy of the hot projection of the element at `idx`, from the column
+  // alone (may lag a concurrent insert or erase)
+  std::optional<Hot> hot_at(std::size_t idx) const
+  {
+    Hot h;
+
+    if (idx >= Capacity || !read_hot(idx, h))
+    {
+      return std::nullopt;
+    }
+
+    return h;
+  }
+
+  // First live element whose hot projection matches pred (slot order).
+  // Scans the hot column; the element is only read to confirm a match.
+  template<typename Predicate>
+  std::optional<Op_Result> find_if_hot(Predicate pred) const
+  {
+    for (std::size_t i = 0; i < Capacity; ++i)
+    {
+      Hot h;
+      std::uint64_t tag = read_hot(i, h);
+
+      if (tag && pred(static_cast<const Hot&>(h)))
+      {
+        if (auto r = confirm(i, tag))
+        {
+          return r;
+        }
+
+        // Stale cell (replaced under us): judge the element itself
+        if (auto r = items.at(i); r && pred(static_cast<const Hot&>(hot_of(r->value))))
+        {
+          return r;
+        }
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  // Call f(index, hot) for every element in the hot column, touching only
+  // the column (like for_each, it may see elements erased meanwhile)
+  template<typename Func>
+  void for_each_hot(Func f) const
+  {
+    for (std::size_t i = 0; i < Capacity; ++i)
+    {
+      Hot h;
+
+      if (read_hot(i, h))
+      {
+        f(i, static_cast<const Hot&>(h));
+      }
+    }
+  }
+
+  std::optional<Op_Result> at(std::size_t idx) const
+  {
+    return items.at(idx);
+  }
+
+  template<typename Predicate>
+  std::optional<Op_Result> find_if(Predicate pred) const
+  {
+    return items.find_if(pred);
+  }
+
+  std::size_t size() const
+  {
+    return items.size();
+  }
+
+  constexpr std::size_t capacity() const
+  {
+    return Capacity;
+  }
+
+  template<typename Func>
+  void for_each(Func f) const
+  {
+    items.for_each(f);
+  }
+};
+
+#endif // LOCKFREE_THREADSAFE_SPLIT_ARRAY
@@ -0,0 +1,210 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+#ifndef LOCKFREE_THREADSAFE_TINY_ARRAY
+#define LOCKFREE_THREADSAFE_TINY_ARRAY
+
+#include "safe_array.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Safe_Array for payloads of 4 bytes or less (enums, small ids, flags). The
+// value lives in the upper half of the slot's state word, so insert, erase,
+// replace and read each come down to one atomic operation on one word: no
+// separate storage write, no INIT phase, no publish step. Values are handed
+// out by copy, so there is nothing to pin and nothing to reclaim late.
+//
+// Slots are Safe_Word_Slots: the value rides in the upper half of the word
+// while READY, where the free-list link sits while EMPTY.
+template<typename T, std::size_t Capacity>
+class Safe_Tiny_Array
+{
+  static_assert(sizeof(T) <= 4, "T must fit in 4 bytes");
+  static_assert(std::is_trivially_copyable<T>::value &&
+    std::is_trivially_default_constructible<T>::value,
+    "T must be trivially copyable and default constructible");
+
+private:
+  using Word = Safe_Slot::Word;
+  using Slots = Safe_Word_Slots<Capacity>;
+
+  Slots slots;
+
+  static Word pack(const T& value)
+  {
+    std::uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(T));
+    return bits;
+  }
+
+  static T unpack(Word st)
+  {
+    std::uint32_t bits = std::uint32_t(Slots::payload_of(st));
+    T value;
+    std::memcpy(&value, &bits, sizeof(T));
+    return value;
+  }
+
+  template<typename... Args>
+  static T make_value(Args&&... args)
+  {
+    if constexpr (std::is_constructible<T, Args&&...>::value)
+    {
+      return T(std::forward<Args>(args)...);
+    }
+    else
+    {
+      return T{ std::forward<Args>(args)... };
+    }
+  }
+
+public:
+  // Values are copies: there is no storage to refer to
+  struct Op_Result
+  {
+    std::size_t index;
+    T value;
+  };
+
+  // Insert T(args...): a free-list pop, then one release store publishes
+  // state, generation and value together. Returns {index, value} or nullopt
+  // if full.
+  template<typename... Args>
+  std::optional<Op_Result> insert(Args&&... args)
+  {
+    T value = make_value(std::forward<Args>(args)...);
+    std::size_t idx;
+
+    if (!slots.claim(idx))
+    {
+      return std::nullopt;
+    }
+
+    slots.publish(idx, pack(value));
+    return Op_Result{ idx, value };
+  }
+
+  // Erase by index (and, if given, generation) with one CAS. Returns true if
+  // the slot held a value.
+  bool erase(std::size_t idx, Word generation = Safe_Slot::ANY_GENERATION)
+  {
+    return slots.erase(idx, generation);
+  }
+
+  // Swap in T(args...) with one CAS, bumping the generation. Returns
+  // {index, new value} or nullopt if the slot is empty.
+  template<typename... Args>
+  std::optional<Op_Result> replace(std::size_t idx, Args&&... args)
+  {
+    if (idx >= Capacity)
+    {
+      return std::nullopt;
+    }
+
+    T value = make_value(std::forward<Args>(args)...);
+    std::atomic<Word>& word = slots.word(idx);
+    Word st = word.load(std::memory_order_acquire);
+
+    do
+    {
+      if (Safe_Slot::state_of(st) != Safe_Slot::READY)
+      {
+        return std::nullopt;
+      }
+    } while (!word.compare_exchange_weak(
+      st, Slots::make(Slots::generation_of(st) + 1, Safe_Slot::READY, pack(value)),
+      std::memory_order_acq_rel,
+      std::memory_order_acquire));
+
+    return Op_Result{ idx, value };
+  }
+
+  // Copy of the value at `idx` if live: one atomic load
+  std::optional<Op_Result> at(std::size_t idx) const
+  {
+    if (idx >= Capacity)
+    {
+      return std::nullopt;
+    }
+
+    Word st = slots.load(idx);
+
+    if (Safe_Slot::state_of(st) != Safe_Slot::READY)
+    {
+      return std::nullopt;
+    }
+
+    return Op_Result{ idx, unpack(st) };
+  }
+
+  // Find with predicate
+  template<typename Predicate>
+  std::optional<Op_Result> find_if(Predicate pred) const
+  {
+    for (std::size_t i = 0, end = slots.touched(); i < end; ++i)
+    {
+      auto r = at(i);
+
+      if (r && pred(r->value))
+      {
+        return r;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  // Find by value
+  std::optional<Op_Result> find(const T& value) const
+  {
+    return find_if([&](const T& v)
+    {
+      return v == value;
+    });
+  }
+
+  // Generation of the slot (30 bits, wrapping); changes on every insert,
+  // erase and replace
+  Word generation(std::size_t idx) const
+  {
+    return slots.generation(idx);
+  }
+
+  // Count live elements (O(slots ever used))
+  std::size_t size() const
+  {
+    return slots.size();
+  }
+
+  constexpr std::size_t capacity() const
+  {
+    return Capacity;
+  }
+
+  // Call f(index, value) for every live element
+  template<typename Func>
+  void for_each(Func f) const
+  {
+    for (std::size_t i = 0, end = slots.touched(); i < end; ++i)
+    {
+      if (auto r = at(i))
+      {
+        f(r->index, r->value);
+      }
+    }
+  }
+
+  constexpr Safe_Tiny_Array()
+  {
+  }
+};
+
+#endif // LOCKFREE_THREADSAFE_TINY_ARRAY
@@ -0,0 +1,105 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+#ifndef LOCKFREE_THREADSAFE_WATERMARKS
+#define LOCKFREE_THREADSAFE_WATERMARKS
+
+#include "safe_array.h"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
+
+// Default watermark callback: flags only
+struct Safe_No_Watermark_Callback
+{
+  void operator()(std::size_t, bool) const
+  {
+  }
+};
+
+// Fill-level thresholds for a Safe_Array, for backpressure that starts
+// before insert() runs out of slots. Attach with array.watch(&marks); each
+// level then keeps a flag for which side of it the array is on, and
+// callback(level, above) runs on every crossing, up or down, on the writing
+// thread that noticed it. Driven by the array's sharded size counters, so
+// crossings are seen late by up to about 1/64 of the capacity; near a level
+// under heavy churn, crossings may also be reported out of order, but the
+// flags settle on the side of the latest update.
+template<typename Callback = Safe_No_Watermark_Callback>
+class Safe_Watermarks : public Safe_Size_Watcher
+{
+public:
+  static constexpr std::size_t MAX_LEVELS = 8;
+
+private:
+  std::array<std::size_t, MAX_LEVELS> levels{};
+  std::array<std::atomic<bool>, MAX_LEVELS> flags{};
+  std::size_t count = 0;
+  Callback callback;
+
+public:
+  // Levels in elements, e.g. { capacity * 80 / 100, capacity * 95 / 100 }
+  explicit Safe_Watermarks(std::initializer_list<std::size_t> marks, Callback callback = Callback())
+    : callback(std::move(callback))
+  {
+    assert(marks.size() <= MAX_LEVELS && "too many watermark levels");
+
+    for (std::size_t level : marks)
+    {
+      if (count < MAX_LEVELS)
+      {
+        levels[count++] = level;
+      }
+    }
+  }
+
+  // True while the array holds at least levels[which] elements (as of the
+  // last update)
+  bool above(std::size_t which) const
+  {
+    return which < count && flags[which].load(std::memory_order_acquire);
+  }
+
+  // True while at or above any level
+  bool above_any() const
+  {
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      if (flags[i].load(std::memory_order_acquire))
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  std::size_t level(std::size_t which) const
+  {
+    return which < count ? levels[which] : 0;
+  }
+
+  // Compare the array's size against every level. Called by Safe_Array.
+  void update(std::size_t live) override
+  {
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      bool now = live >= levels[i];
+
+      // Cheap read first: most updates cross nothing
+      if (flags[i].load(std::memory_order_relaxed) != now &&
+        flags[i].exchange(now, std::memory_order_acq_rel) != now)
+      {
+        callback(levels[i], now);
+      }
+    }
+  }
+};
+
+#endif // LOCKFREE_THREADSAFE_WATERMARKS
@@ -0,0 +1,222 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// at_many/visit_many over index lists longer than the prefetch window that
+// mix live, erased, replaced (still aliased under a Guard), duplicate and
+// out-of-range indices: every out[k] must be exactly what at(indices[k])
+// gives, and visit_many must visit the live ones in the order given. Then
+// the same checks race concurrent writers. Build as in stress.h.
+
+#include "safe_array.h"
+#include "stress.h"
+
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+constexpr std::size_t N = 64;
+using Array = Safe_Array<std::string, N>;
+
+static std::string value_for(std::size_t n)
+{
+  return "element-with-a-long-enough-payload-" + std::to_string(n);
+}
+
+static bool well_formed(const std::string& s)
+{
+  return s.compare(0, 35, value_for(0), 0, 35) == 0;
+}
+
+// visit_many saw a subsequence of `indices`: each visit at or after the
+// position of the previous one
+static bool in_input_order(const std::vector<std::size_t>& indices,
+  const std::vector<std::size_t>& visited)
+{
+  std::size_t pos = 0;
+
+  for (std::size_t idx : visited)
+  {
+    while (pos < indices.size() && indices[pos] != idx)
+    {
+      ++pos;
+    }
+
+    if (pos == indices.size())
+    {
+      return false;
+    }
+
+    ++pos;
+  }
+
+  return true;
+}
+
+static void deterministic()
+{
+  Array arr;
+
+  for (std::size_t i = 0; i < 48; ++i)
+  {
+    arr.insert(value_for(i));
+  }
+
+  // Erase every third slot; replace slot 1 while a Guard pins its old
+  // value, so it reads through its alias
+  for (std::size_t i = 0; i < 48; i += 3)
+  {
+    arr.erase(i);
+  }
+
+  auto old = arr.acquire(1);
+  STRESS_CHECK(arr.replace(1, value_for(1001)));
+
+  std::vector<std::size_t> indices;
+
+  for (std::size_t k = 0; k < 100; ++k)
+  {
+    indices.push_back((k * 37) % (N + 8)); // Includes never-used and out-of-range slots
+  }
+
+  indices.push_back(std::numeric_limits<std::size_t>::max());
+  indices.push_back(1);
+  indices.push_back(1);
+
+  // Stale contents must be overwritten, present or not
+  std::vector<std::optional<Array::Op_Result>> out(indices.size());
+
+  for (auto& o : out)
+  {
+    o.emplace(*arr.at(2));
+  }
+
+  std::size_t found = arr.at_many(indices.data(), indices.size(), out.data());
+  std::size_t live = 0;
+  std::vector<std::size_t> expected;
+
+  for (std::size_t k = 0; k < indices.size(); ++k)
+  {
+    auto r = arr.at(indices[k]);
+    STRESS_CHECK(bool(out[k]) == bool(r));
+
+    if (r)
+    {
+      ++live;
+      expected.push_back(indices[k]);
+      STRESS_CHECK(out[k]->index == indices[k] && &out[k]->value == &r->value);
+      STRESS_CHECK(out[k]->value == (indices[k] == 1 ? value_for(1001) : value_for(indices[k])));
+    }
+    else
+    {
+      STRESS_CHECK(indices[k] >= 48 || indices[k] % 3 == 0);
+    }
+  }
+
+  STRESS_CHECK(found == live);
+  STRESS_CHECK(live > 0 && live < indices.size());
+
+  std::vector<std::size_t> visited;
+
+  arr.visit_many(indices.data(), indices.size(), [&](std::size_t idx, const std::string& value)
+  {
+    visited.push_back(idx);
+    STRESS_CHECK(value == arr.at(idx)->value);
+  });
+
+  STRESS_CHECK(visited == expected);
+  STRESS_CHECK(**old == value_for(1));
+
+  // Empty batches touch nothing
+  STRESS_CHECK(arr.at_many(indices.data(), 0, out.data()) == 0);
+  arr.visit_many(indices.data(), 0, [&](std::size_t, const std::string&)
+  {
+    STRESS_CHECK(!"visited an empty batch");
+  });
+}
+
+int main(int argc, char** argv)
+{
+  deterministic();
+
+  Array arr;
+
+  stress::run(6, stress::duration(argc, argv), [&](std::size_t t, std::mt19937_64& rng)
+  {
+    std::size_t idx = rng() % N;
+
+    if (t < 3)
+    {
+      switch (rng() % 3)
+      {
+      case 0:
+        arr.insert(value_for(rng() % 1000));
+        break;
+      case 1:
+        arr.erase(idx);
+        break;
+      default:
+        arr.replace(idx, value_for(rng() % 1000));
+        break;
+      }
+
+      return;
+    }
+
+    std::vector<std::size_t> indices(40);
+
+    for (auto& i : indices)
+    {
+      i = rng() % (N + 4);
+    }
+
+    if (rng() % 2 == 0)
+    {
+      // Values are not pinned, so only their slots are checked here
+      std::vector<std::optional<Array::Op_Result>> out(indices.size());
+      std::size_t found = arr.at_many(indices.data(), indices.size(), out.data());
+      std::size_t live = 0;
+
+      for (std::size_t k = 0; k < indices.size(); ++k)
+      {
+        STRESS_CHECK(!out[k] || out[k]->index == indices[k]);
+        STRESS_CHECK(!out[k] || indices[k] < N);
+        live += out[k] ? 1 : 0;
+      }
+
+      STRESS_CHECK(found == live);
+    }
+    else
+    {
+      std::vector<std::size_t> visited;
+
+      arr.visit_many(indices.data(), indices.size(), [&](std::size_t i, const std::string&)
+      {
+        visited.push_back(i);
+      });
+
+      STRESS_CHECK(in_input_order(indices, visited));
+    }
+  });
+
+  // Quiescent: a batch over every slot agrees with at() and the count
+  std::vector<std::size_t> all(N);
+
+  for (std::size_t i = 0; i < N; ++i)
+  {
+    all[i] = i;
+  }
+
+  std::vector<std::optional<Array::Op_Result>> out(N);
+  STRESS_CHECK(arr.at_many(all.data(), N, out.data()) == arr.size());
+
+  for (std::size_t i = 0; i < N; ++i)
+  {
+    STRESS_CHECK(bool(out[i]) == bool(arr.at(i)));
+    STRESS_CHECK(!out[i] || well_formed(out[i]->value));
+  }
+
+  return stress::report("batch_lookup_stress");
+}
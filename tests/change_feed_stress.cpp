@@ -0,0 +1,144 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Array with a Safe_Change_Feed under concurrent insert/erase/replace/
+// transactions, followed by a subscriber that keeps a replica of which
+// slots are live. Writers hold back when the subscriber lags, so no record
+// is lost; once quiescent the replica must match the array. Build as in
+// stress.h.
+
+#include "safe_array.h"
+#include "safe_change_feed.h"
+#include "stress.h"
+
+#include <array>
+#include <string>
+
+constexpr std::size_t N = 64;
+constexpr std::size_t RING = 1 << 12;
+
+using Array = Safe_Array<std::string, N, Safe_Change_Feed<RING>>;
+
+static std::string value_for(std::size_t n)
+{
+  return "element-with-a-long-enough-payload-" + std::to_string(n);
+}
+
+// Latest change seen for one slot. Records of different writers can arrive
+// out of order, so keep the newest by generation; an erase reports the
+// generation of the element it erased, so it wins a tie with its insert.
+struct Replica_Slot
+{
+  Safe_Slot::Word key = 0;
+  bool live = false;
+  Safe_Slot::Word generation = 0;
+};
+
+int main(int argc, char** argv)
+{
+  static Array arr;
+  auto cursor = arr.changes().subscribe();
+  std::array<Replica_Slot, N> replica{};
+  std::atomic<std::uint64_t> applied{ 0 };
+  std::atomic<bool> stop{ false };
+
+  auto apply = [&](const Safe_Change_Feed<RING>::Change& c)
+  {
+    STRESS_CHECK(c.index < N);
+
+    if (c.index >= N)
+    {
+      return;
+    }
+
+    Safe_Slot::Word key = c.generation * 2 + (c.op == Safe_Change_Op::ERASE ? 1 : 0) + 1;
+    Replica_Slot& r = replica[c.index];
+
+    if (key > r.key)
+    {
+      r = { key, c.op != Safe_Change_Op::ERASE, c.generation };
+    }
+
+    applied.fetch_add(1, std::memory_order_release);
+  };
+
+  std::thread subscriber([&]
+  {
+    while (!stop.load())
+    {
+      if (auto c = arr.changes().poll(cursor))
+      {
+        apply(*c);
+      }
+      else
+      {
+        STRESS_CHECK(!cursor.lost());
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  stress::run(6, stress::duration(argc, argv), [&](std::size_t, std::mt19937_64& rng)
+  {
+    // Stay well within the ring, so the subscriber never loses records
+    if (arr.changes().published() - applied.load(std::memory_order_acquire) > RING / 2)
+    {
+      std::this_thread::yield();
+      return;
+    }
+
+    std::size_t idx = rng() % N;
+
+    switch (rng() % 5)
+    {
+    case 0:
+    case 1:
+      arr.insert(value_for(rng() % 1000));
+      break;
+
+    case 2:
+      arr.erase(idx);
+      break;
+
+    case 3:
+      arr.replace(idx, value_for(rng() % 1000));
+      break;
+
+    default:
+    {
+      auto txn = arr.transaction();
+      txn.erase(idx);
+      txn.insert(value_for(rng() % 1000));
+      txn.commit();
+      break;
+    }
+    }
+  });
+
+  stop.store(true);
+  subscriber.join();
+
+  // Quiescent: drain the rest, then the replica matches the array
+  while (auto c = arr.changes().poll(cursor))
+  {
+    apply(*c);
+  }
+
+  STRESS_CHECK(!cursor.lost());
+  STRESS_CHECK(applied.load() == arr.changes().published());
+
+  for (std::size_t i = 0; i < N; ++i)
+  {
+    bool live = bool(arr.at(i));
+    STRESS_CHECK(replica[i].live == live);
+
+    if (live)
+    {
+      STRESS_CHECK(replica[i].generation == (arr.generation(i) & 0xFFFFFFFFULL));
+    }
+  }
+
+  return stress::report("change_feed_stress");
+}
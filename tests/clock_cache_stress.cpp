@@ -0,0 +1,92 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Clock_Cache kept full, so nearly every insert evicts, while readers
+// hold Guards on the elements being evicted. Build as in stress.h.
+
+#include "safe_clock_cache.h"
+#include "stress.h"
+
+#include <string>
+
+using Cache = Safe_Clock_Cache<std::string, 16>;
+
+static std::string value_for(std::size_t n)
+{
+  return "element-with-a-long-enough-payload-" + std::to_string(n);
+}
+
+static bool well_formed(const std::string& s)
+{
+  return s.compare(0, 35, value_for(0), 0, 35) == 0;
+}
+
+int main(int argc, char** argv)
+{
+  Cache cache;
+
+  stress::run(6, stress::duration(argc, argv), [&](std::size_t t, std::mt19937_64& rng)
+  {
+    std::size_t idx = rng() % cache.capacity();
+
+    switch (rng() % 5)
+    {
+    case 0:
+      // Unpinned result: not read
+      cache.insert(value_for(t));
+      break;
+    case 1:
+      if (auto g = cache.insert_pinned(value_for(t)))
+      {
+        std::this_thread::yield();
+        STRESS_CHECK(**g == value_for(t));
+      }
+      break;
+    case 2:
+      if (auto g = cache.acquire(idx))
+      {
+        std::string copy = **g;
+        std::this_thread::yield();
+        STRESS_CHECK(well_formed(copy) && **g == copy);
+      }
+      break;
+    case 3:
+      if (auto g = cache.acquire_if([&](const std::string& s) { return s == value_for(t); }))
+      {
+        STRESS_CHECK(**g == value_for(t));
+      }
+      break;
+    default:
+      if (rng() % 2)
+      {
+        cache.erase(idx);
+      }
+      else
+      {
+        cache.evict();
+      }
+      break;
+    }
+  });
+
+  // Quiescent: unpinned reads are safe again
+  std::size_t live = 0;
+
+  cache.for_each([&](std::size_t, std::string& s)
+  {
+    STRESS_CHECK(well_formed(s));
+    ++live;
+  });
+
+  STRESS_CHECK(live == cache.size());
+
+  while (cache.size() < cache.capacity())
+  {
+    STRESS_CHECK(cache.insert(value_for(0)));
+  }
+
+  STRESS_CHECK(cache.insert(value_for(1)) && cache.size() == cache.capacity());
+  return stress::report("clock_cache_stress");
+}
@@ -0,0 +1,100 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Column_Array under concurrent inserts and erases while rows are read;
+// a row must never show another element's members. Build as in stress.h
+// (C++20 only).
+
+#include "safe_column_array.h"
+#include "stress.h"
+
+#include <cstdint>
+#include <vector>
+
+struct Flow
+{
+  std::uint64_t bytes;
+  std::uint32_t id;
+  std::uint32_t check; // ~id
+};
+
+using Flows = Safe_Column_Array<Flow, 32, &Flow::bytes, &Flow::id, &Flow::check>;
+
+static Flow flow_for(std::uint32_t id)
+{
+  return Flow{ std::uint64_t(id) * 3, id, ~id };
+}
+
+static bool well_formed(const Flow& f)
+{
+  return f.check == ~f.id && f.bytes == std::uint64_t(f.id) * 3;
+}
+
+int main(int argc, char** argv)
+{
+  Flows flows;
+
+  stress::run(6, stress::duration(argc, argv), [&](std::size_t, std::mt19937_64& rng)
+  {
+    std::size_t idx = rng() % flows.capacity();
+
+    switch (rng() % 4)
+    {
+    case 0:
+      if (auto r = flows.insert(flow_for(std::uint32_t(rng()))))
+      {
+        auto f = r->value.load();
+        STRESS_CHECK(!f || well_formed(*f));
+      }
+      break;
+    case 1:
+      flows.erase(idx);
+      break;
+    case 2:
+      if (auto r = flows.at(idx))
+      {
+        auto f = r->value.load();
+        STRESS_CHECK(!f || well_formed(*f));
+      }
+      break;
+    default:
+      flows.for_each([&](std::size_t, const Flows::Row& row)
+      {
+        auto id = row.get<&Flow::id>();
+        auto check = row.get<&Flow::check>();
+        STRESS_CHECK(!id || !check || *check == ~*id);
+      });
+      break;
+    }
+  });
+
+  // Quiescent: rows and column ranges agree, and every free slot comes
+  // back exactly once
+  std::size_t live = 0;
+  std::vector<bool> seen(flows.capacity());
+
+  flows.for_each_column<&Flow::id>([&](std::size_t first, const std::uint32_t* ids, std::size_t n)
+  {
+    for (std::size_t k = 0; k < n; ++k)
+    {
+      auto f = flows.at(first + k)->value.load();
+      STRESS_CHECK(f && well_formed(*f) && f->id == ids[k]);
+      seen[first + k] = true;
+      ++live;
+    }
+  });
+
+  STRESS_CHECK(live == flows.size());
+
+  while (auto r = flows.insert(flow_for(0)))
+  {
+    STRESS_CHECK(!seen[r->index]);
+    seen[r->index] = true;
+    ++live;
+  }
+
+  STRESS_CHECK(live == flows.capacity());
+  return stress::report("column_array_stress");
+}
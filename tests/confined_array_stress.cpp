@@ -0,0 +1,167 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Concurrency::NONE (thread-confined) Safe_Array driven by one thread
+// through random inserts, erases, replaces (some under a Guard) and
+// transactions, checked step by step against a plain model of which slot
+// holds what. Build as in stress.h.
+
+#include "safe_array.h"
+#include "stress.h"
+
+#include <array>
+#include <optional>
+#include <string>
+
+constexpr std::size_t N = 16;
+
+using Array = Safe_Array<std::string, N, Safe_No_Feed, Safe_Concurrency::NONE>;
+using Model = std::array<std::optional<std::string>, N>;
+
+static std::string value_for(std::size_t n)
+{
+  return "element-with-a-long-enough-payload-" + std::to_string(n);
+}
+
+static std::size_t live_in(const Model& model)
+{
+  std::size_t n = 0;
+
+  for (const auto& v : model)
+  {
+    n += v ? 1 : 0;
+  }
+
+  return n;
+}
+
+// The array holds exactly what the model says, and every count agrees
+static void check_matches(const Array& arr, const Model& model)
+{
+  for (std::size_t i = 0; i < N; ++i)
+  {
+    auto r = arr.at(i);
+    STRESS_CHECK(bool(r) == bool(model[i]));
+
+    if (r && model[i])
+    {
+      STRESS_CHECK(r->value == *model[i]);
+    }
+  }
+
+  std::size_t live = live_in(model);
+  STRESS_CHECK(arr.size() == live);
+  STRESS_CHECK(arr.exact_size() == live);
+  STRESS_CHECK(arr.approx_size() == live);
+}
+
+int main(int argc, char** argv)
+{
+  Array arr;
+  Model model{};
+
+  stress::run(1, stress::duration(argc, argv), [&](std::size_t, std::mt19937_64& rng)
+  {
+    std::size_t idx = rng() % N;
+    std::string value = value_for(rng() % 1000);
+
+    switch (rng() % 5)
+    {
+    case 0:
+    case 1:
+      if (auto r = arr.insert(value))
+      {
+        STRESS_CHECK(!model[r->index] && r->value == value);
+        model[r->index] = value;
+      }
+      else
+      {
+        STRESS_CHECK(live_in(model) == N);
+      }
+      break;
+
+    case 2:
+      STRESS_CHECK(arr.erase(idx) == bool(model[idx]));
+      model[idx].reset();
+      break;
+
+    case 3:
+    {
+      // A replace needs one free slot for the new value while it runs;
+      // under a Guard the old value stays readable until released
+      bool expect = model[idx] && live_in(model) < N;
+      std::optional<Array::Guard> g;
+
+      if (rng() % 2 == 0)
+      {
+        g = arr.acquire(idx);
+        STRESS_CHECK(bool(g) == bool(model[idx]));
+      }
+
+      auto r = arr.replace(idx, value);
+      STRESS_CHECK(bool(r) == expect);
+
+      if (g)
+      {
+        STRESS_CHECK(**g == *model[idx]);
+      }
+
+      if (r)
+      {
+        model[idx] = value;
+      }
+      break;
+    }
+
+    default:
+    {
+      // Erase one slot and insert another in one step (just the erase if
+      // the array is full); a dropped transaction leaves everything as it
+      // was
+      auto txn = arr.transaction();
+      bool staged = txn.erase(idx);
+      auto ins = txn.insert(value);
+      bool commit = rng() % 4 != 0;
+      bool done = commit && txn.commit();
+
+      STRESS_CHECK(staged);
+      STRESS_CHECK(bool(ins) == (live_in(model) < N));
+      STRESS_CHECK(done == (commit && bool(model[idx])));
+
+      if (done)
+      {
+        model[idx].reset();
+
+        if (ins)
+        {
+          model[ins->index] = value;
+        }
+      }
+      break;
+    }
+    }
+
+    check_matches(arr, model);
+  });
+
+  // Emptied, every slot can be filled again
+  for (std::size_t i = 0; i < N; ++i)
+  {
+    arr.erase(i);
+    model[i].reset();
+  }
+
+  check_matches(arr, model);
+
+  for (std::size_t i = 0; i < N; ++i)
+  {
+    STRESS_CHECK(arr.insert(value_for(i)));
+  }
+
+  STRESS_CHECK(!arr.insert(value_for(0)));
+  STRESS_CHECK(arr.size() == N);
+
+  return stress::report("confined_array_stress");
+}
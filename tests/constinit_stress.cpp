@@ -0,0 +1,115 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Static tables: the default, SINGLE_WRITER, tiny and column arrays must be
+// constant-initializable, so `constinit` globals of them compile (C++20;
+// C++17 builds only check that they work from zeroed storage). Each is then
+// used from a few threads. Safe_Change_Feed sets up its ring at runtime, so
+// an array with that feed is deliberately not among them. Build as in
+// stress.h.
+
+#include "safe_array.h"
+#include "safe_tiny_array.h"
+#include "stress.h"
+
+#if defined(__cpp_lib_atomic_ref)
+#include "safe_column_array.h"
+#endif
+
+#include <cstdint>
+#include <string>
+
+#if defined(__cpp_constinit)
+#define STATIC_TABLE constinit
+#else
+#define STATIC_TABLE
+#endif
+
+struct Flow
+{
+  std::uint64_t bytes;
+  std::uint32_t id;
+};
+
+STATIC_TABLE Safe_Array<std::string, 64> shared_table;
+STATIC_TABLE Safe_Array<std::string, 64, Safe_No_Feed, Safe_Concurrency::SINGLE_WRITER> writer_table;
+STATIC_TABLE Safe_Tiny_Array<std::uint32_t, 64> tiny_table;
+
+#if defined(__cpp_lib_atomic_ref)
+STATIC_TABLE Safe_Column_Array<Flow, 64, &Flow::bytes, &Flow::id> column_table;
+#endif
+
+static std::string value_for(std::size_t n)
+{
+  return "element-with-a-long-enough-payload-" + std::to_string(n);
+}
+
+int main(int argc, char** argv)
+{
+  // Nothing ran before main: every table starts out empty
+  STRESS_CHECK(shared_table.size() == 0 && writer_table.size() == 0 && tiny_table.size() == 0);
+
+  stress::run(4, stress::duration(argc, argv), [&](std::size_t t, std::mt19937_64& rng)
+  {
+    std::size_t idx = rng() % 64;
+
+    if (rng() % 2 == 0)
+    {
+      shared_table.insert(value_for(idx));
+      tiny_table.insert(std::uint32_t(idx));
+
+#if defined(__cpp_lib_atomic_ref)
+      column_table.insert(Flow{ idx, std::uint32_t(idx) });
+#endif
+    }
+    else
+    {
+      shared_table.erase(idx);
+      tiny_table.erase(idx);
+
+#if defined(__cpp_lib_atomic_ref)
+      column_table.erase(idx);
+#endif
+    }
+
+    // Only thread 0 writes the single-writer table
+    if (t == 0)
+    {
+      if (rng() % 2 == 0)
+      {
+        writer_table.insert(value_for(idx));
+      }
+      else
+      {
+        writer_table.erase(idx);
+      }
+    }
+  });
+
+  // Quiescent: each table fills to capacity
+  while (shared_table.insert(value_for(0)))
+  {
+  }
+
+  while (writer_table.insert(value_for(0)))
+  {
+  }
+
+  while (tiny_table.insert(0u))
+  {
+  }
+
+  STRESS_CHECK(shared_table.size() == 64 && writer_table.size() == 64 && tiny_table.size() == 64);
+
+#if defined(__cpp_lib_atomic_ref)
+  while (column_table.insert(Flow{ 0, 0 }))
+  {
+  }
+
+  STRESS_CHECK(column_table.size() == 64);
+#endif
+
+  return stress::report("constinit_stress");
+}
@@ -0,0 +1,100 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Dynamic_Capacity arrays on the default resource (entries built one
+// by one) and on huge pages (entries built by the resource, on several
+// threads), under concurrent insert/erase/acquire. Build as in stress.h.
+
+#include "safe_array.h"
+#include "safe_huge_pages.h"
+#include "stress.h"
+
+#include <stdexcept>
+#include <string>
+
+using Array = Safe_Array<std::string, Safe_Dynamic_Capacity>;
+
+static std::string value_for(std::size_t n)
+{
+  return "element-with-a-long-enough-payload-" + std::to_string(n);
+}
+
+static bool well_formed(const std::string& s)
+{
+  return s.compare(0, 35, value_for(0), 0, 35) == 0;
+}
+
+static void exercise(Array& arr, std::chrono::milliseconds time)
+{
+  stress::run(4, time, [&](std::size_t t, std::mt19937_64& rng)
+  {
+    std::size_t idx = rng() % arr.capacity();
+
+    switch (rng() % 3)
+    {
+    case 0:
+      arr.insert(value_for(t));
+      break;
+    case 1:
+      arr.erase(idx);
+      break;
+    default:
+      if (auto g = arr.acquire(idx))
+      {
+        STRESS_CHECK(well_formed(**g));
+      }
+      break;
+    }
+  });
+
+  // Quiescent: fill what is left; the destructor frees every element
+  while (arr.insert(value_for(0)))
+  {
+  }
+
+  STRESS_CHECK(arr.size() == arr.capacity() && arr.exact_size() == arr.capacity());
+}
+
+int main(int argc, char** argv)
+{
+  auto time = stress::duration(argc, argv) / 2;
+
+  // Slot indices must fit in 32 bits, in release builds too
+  try
+  {
+    Array too_big(std::size_t(1) << 32);
+    STRESS_CHECK(!"capacity past 32 bits accepted");
+  }
+  catch (const std::length_error&)
+  {
+  }
+
+  {
+    Array arr(48);
+    exercise(arr, time);
+  }
+
+  {
+    Safe_Huge_Page_Resource pages({ true, 2, false });
+    Array arr(48, &pages);
+    STRESS_CHECK(arr.resource() == &pages && arr.size() == 0);
+    exercise(arr, time);
+  }
+
+  {
+    // Several huge pages, so the entries are built on both threads: every
+    // one of them must start out empty
+    Safe_Huge_Page_Resource pages({ false, 2, false });
+    Array arr(std::size_t(1) << 17, &pages);
+
+    while (arr.insert(value_for(0)))
+    {
+    }
+
+    STRESS_CHECK(arr.size() == arr.capacity());
+  }
+
+  return stress::report("dynamic_array_stress");
+}
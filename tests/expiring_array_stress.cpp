@@ -0,0 +1,127 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Expiring_Array under concurrent inserts with and without deadlines,
+// deadline changes, erases and a reaper. Build as in stress.h.
+
+#include "safe_expiring_array.h"
+#include "stress.h"
+
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+using Array = Safe_Expiring_Array<std::string, 32>;
+
+static std::string value_for(std::size_t n)
+{
+  return "element-with-a-long-enough-payload-" + std::to_string(n);
+}
+
+// A plain insert into a slot whose previous element had a deadline must not
+// inherit it, however many times the slot is reused
+static void reuse_without_deadline()
+{
+  Array arr;
+  auto r = arr.insert_until(Clock::now() - std::chrono::milliseconds(10), value_for(0));
+  std::size_t idx = r->index;
+  STRESS_CHECK(!arr.at(idx));
+  STRESS_CHECK(arr.erase(idx));
+
+  for (std::size_t i = 0; i < (std::size_t(1) << 17); ++i)
+  {
+    auto again = arr.insert(value_for(i));
+    STRESS_CHECK(again && again->index == idx);
+
+    if (!arr.at(idx))
+    {
+      STRESS_CHECK(!"plain insert read as expired");
+      return;
+    }
+
+    arr.erase(idx);
+  }
+}
+
+// Bringing a deadline forward must let reap() erase the element then, not
+// when the wheel reaches the old deadline
+static void bring_forward()
+{
+  Array arr;
+  auto r = arr.insert_for(std::chrono::hours(1), value_for(0));
+  STRESS_CHECK(arr.reap() == 0);
+  STRESS_CHECK(arr.expire_at(r->index, Clock::now() + std::chrono::milliseconds(1)));
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  STRESS_CHECK(arr.reap() == 1);
+  STRESS_CHECK(arr.size() == 0);
+}
+
+int main(int argc, char** argv)
+{
+  reuse_without_deadline();
+  bring_forward();
+
+  Array arr;
+  std::atomic<bool> stop{ false };
+
+  std::thread reaper([&]
+  {
+    while (!stop.load())
+    {
+      arr.reap();
+      std::this_thread::yield();
+    }
+  });
+
+  stress::run(6, stress::duration(argc, argv), [&](std::size_t t, std::mt19937_64& rng)
+  {
+    std::size_t idx = rng() % arr.capacity();
+    auto ttl = std::chrono::microseconds(rng() % 4000);
+
+    switch (rng() % 6)
+    {
+    case 0:
+      arr.insert(value_for(t));
+      break;
+    case 1:
+      arr.insert_for(ttl, value_for(t));
+      break;
+    case 2:
+      arr.insert_for(std::chrono::hours(1), value_for(t));
+      break;
+    case 3:
+      arr.expire_at(idx, Clock::now() + ttl);
+      break;
+    case 4:
+      arr.erase(idx);
+      break;
+    default:
+      // Values are only read once the writers stop; here just their presence
+      arr.at(idx);
+      arr.size();
+      break;
+    }
+  });
+
+  stop.store(true);
+  reaper.join();
+
+  // Quiescent: a reap far enough ahead erases everything with a deadline,
+  // wherever the wheel had it filed
+  auto later = Clock::now() + std::chrono::hours(2);
+  arr.reap(later);
+
+  for (std::size_t i = 0; i < arr.capacity(); ++i)
+  {
+    auto now = arr.at(i);
+    STRESS_CHECK(bool(now) == bool(arr.at(i, later)));
+
+    if (now)
+    {
+      STRESS_CHECK(now->value.compare(0, 35, value_for(0), 0, 35) == 0);
+    }
+  }
+
+  return stress::report("expiring_array_stress");
+}
@@ -0,0 +1,79 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Hash_Map under concurrent insert/erase/find/acquire with std::string
+// keys, on more keys than slots so the map keeps filling up and nodes keep
+// being recycled. Build as in stress.h.
+
+#include "safe_hash_map.h"
+#include "stress.h"
+
+#include <set>
+#include <string>
+
+static std::string key_for(std::size_t n)
+{
+  return "session-key-long-enough-to-allocate-" + std::to_string(n);
+}
+
+int main(int argc, char** argv)
+{
+  constexpr std::size_t KEYS = 128;
+  Safe_Hash_Map<std::string, std::string, 64> map;
+
+  stress::run(6, stress::duration(argc, argv), [&](std::size_t, std::mt19937_64& rng)
+  {
+    std::string key = key_for(rng() % KEYS);
+
+    switch (rng() % 4)
+    {
+    case 0:
+      map.insert(key, key + "/value"); // Unpinned result: not read
+      break;
+
+    case 1:
+      map.erase(key);
+      break;
+
+    case 2:
+      if (auto r = map.find(key))
+      {
+        STRESS_CHECK(r->index < map.capacity());
+      }
+      break;
+
+    default:
+      if (auto g = map.acquire(key))
+      {
+        STRESS_CHECK((*g)->key == key);
+        STRESS_CHECK((*g)->value == key + "/value");
+      }
+      break;
+    }
+  });
+
+  // Quiescent: every live key appears once and is found where it lives
+  std::set<std::string> seen;
+  std::size_t live = 0;
+
+  map.for_each([&](const std::string& key, const std::string& value)
+  {
+    STRESS_CHECK(seen.insert(key).second);
+    STRESS_CHECK(value == key + "/value");
+    ++live;
+  });
+
+  STRESS_CHECK(live == map.size());
+
+  for (const auto& key : seen)
+  {
+    auto r = map.find(key);
+    STRESS_CHECK(r && r->key == key);
+    STRESS_CHECK(map.erase(key));
+  }
+
+  STRESS_CHECK(map.size() == 0);
+  return stress::report("hash_map_stress");
+}
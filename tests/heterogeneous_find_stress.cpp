@@ -0,0 +1,165 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Heterogeneous lookups against std::string elements and keys: find() with
+// a std::string_view and with a string literal must hit and miss exactly as
+// find() with a std::string does, in Safe_Array, Safe_Clock_Cache,
+// Safe_Ordered_Array and a Safe_Hash_Map with transparent functors (which
+// must hash the lookup key as given, never as a converted std::string).
+// Then string_view lookups race inserts and erases on the map. Build as in
+// stress.h.
+
+#include "safe_array.h"
+#include "safe_clock_cache.h"
+#include "safe_hash_map.h"
+#include "safe_ordered_array.h"
+#include "stress.h"
+
+#include <string>
+#include <string_view>
+
+// Counts hashes of std::string keys, so a lookup that converted its key
+// shows up
+struct Sv_Hash
+{
+  using is_transparent = void;
+  static inline std::atomic<std::size_t> string_hashes{ 0 };
+
+  std::size_t operator()(std::string_view s) const
+  {
+    return std::hash<std::string_view>{}(s);
+  }
+
+  std::size_t operator()(const char* s) const
+  {
+    return (*this)(std::string_view(s));
+  }
+
+  std::size_t operator()(const std::string& s) const
+  {
+    string_hashes.fetch_add(1, std::memory_order_relaxed);
+    return (*this)(std::string_view(s));
+  }
+};
+
+using Map = Safe_Hash_Map<std::string, std::string, 64, Sv_Hash, std::equal_to<>>;
+
+static std::string key_for(std::size_t n)
+{
+  return "session-key-long-enough-to-allocate-" + std::to_string(n);
+}
+
+// Hit and miss by string_view and by literal on a container of strings
+template<typename Container>
+static void check_lookups(Container& c, const char* name)
+{
+  std::size_t failures = stress::failures.load();
+  std::string key = key_for(7);
+  std::string_view view = key;
+
+  auto hit = c.find(view);
+  STRESS_CHECK(hit && hit->value == key);
+
+  auto literal = c.find("session-key-long-enough-to-allocate-7");
+  STRESS_CHECK(literal && literal->index == hit->index);
+
+  STRESS_CHECK(!c.find(std::string_view("session-key-long-enough-to-allocate-99")));
+  STRESS_CHECK(!c.find("no-such-session"));
+
+  // A view of a longer buffer compares only its own characters
+  std::string longer = key + "-suffix";
+  STRESS_CHECK(c.find(std::string_view(longer).substr(0, key.size())));
+  STRESS_CHECK(!c.find(std::string_view(longer)));
+
+  if (stress::failures.load() != failures)
+  {
+    std::printf("%s: lookups failed\n", name);
+  }
+}
+
+static void containers()
+{
+  Safe_Array<std::string, 16> arr;
+  Safe_Clock_Cache<std::string, 16> cache;
+  Safe_Ordered_Array<std::string, 16> ordered;
+
+  for (std::size_t i = 0; i < 10; ++i)
+  {
+    arr.insert(key_for(i));
+    cache.insert(key_for(i));
+    ordered.insert(key_for(i));
+  }
+
+  check_lookups(arr, "Safe_Array");
+  check_lookups(cache, "Safe_Clock_Cache");
+  check_lookups(ordered, "Safe_Ordered_Array");
+
+  Map map;
+
+  for (std::size_t i = 0; i < 10; ++i)
+  {
+    map.insert(key_for(i), key_for(i) + "/value");
+  }
+
+  std::size_t before = Sv_Hash::string_hashes.load();
+  std::string key = key_for(7);
+
+  auto hit = map.find(std::string_view(key));
+  STRESS_CHECK(hit && hit->key == key && hit->value == key + "/value");
+  STRESS_CHECK(map.find("session-key-long-enough-to-allocate-7"));
+  STRESS_CHECK(!map.find(std::string_view("session-key-long-enough-to-allocate-99")));
+  STRESS_CHECK(!map.find("no-such-session"));
+  STRESS_CHECK(map.erase(std::string_view(key)));
+  STRESS_CHECK(!map.find(std::string_view(key)));
+
+  // None of those lookups hashed a std::string
+  STRESS_CHECK(Sv_Hash::string_hashes.load() == before);
+}
+
+int main(int argc, char** argv)
+{
+  containers();
+
+  constexpr std::size_t KEYS = 96;
+  Map map;
+
+  stress::run(4, stress::duration(argc, argv), [&](std::size_t, std::mt19937_64& rng)
+  {
+    std::string key = key_for(rng() % KEYS);
+    std::string_view view = key;
+
+    switch (rng() % 3)
+    {
+    case 0:
+      map.insert(key, key + "/value");
+      break;
+
+    case 1:
+      map.erase(view);
+      break;
+
+    default:
+      if (auto g = map.acquire(view))
+      {
+        STRESS_CHECK((*g)->key == view);
+        STRESS_CHECK((*g)->value == key + "/value");
+      }
+      break;
+    }
+  });
+
+  // Quiescent: a view finds a key exactly when the std::string does
+  for (std::size_t i = 0; i < KEYS; ++i)
+  {
+    std::string key = key_for(i);
+    auto by_string = map.find(key);
+    auto by_view = map.find(std::string_view(key));
+
+    STRESS_CHECK(bool(by_string) == bool(by_view));
+    STRESS_CHECK(!by_view || by_view->index == by_string->index);
+  }
+
+  return stress::report("heterogeneous_find_stress");
+}
@@ -0,0 +1,89 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Live_Array under concurrent insert/erase/for_each_live on a small
+// array, so slots are unlinked and relinked while walks and sweeps pass
+// through them. A cycle in the live list shows up as a hang (run it under
+// `timeout`). Build as in stress.h.
+
+#include "safe_live_array.h"
+#include "stress.h"
+
+#include <string>
+#include <vector>
+
+struct Item
+{
+  std::string name;
+  std::size_t serial;
+};
+
+int main(int argc, char** argv)
+{
+  constexpr std::size_t SLOTS = 64;
+  Safe_Live_Array<Item, SLOTS> arr;
+  std::atomic<std::size_t> serial{ 0 };
+
+  stress::run(6, stress::duration(argc, argv), [&](std::size_t, std::mt19937_64& rng)
+  {
+    switch (rng() % 3)
+    {
+    case 0:
+    {
+      std::size_t s = serial.fetch_add(1);
+      arr.insert(Item{ "item-with-a-long-enough-name-" + std::to_string(s), s });
+      break;
+    }
+
+    case 1:
+      arr.erase(rng() % SLOTS);
+      break;
+
+    default:
+    {
+      arr.for_each_live([&](std::size_t i, const Item& item)
+      {
+        STRESS_CHECK(i < SLOTS);
+        STRESS_CHECK(item.name == "item-with-a-long-enough-name-" + std::to_string(item.serial));
+      });
+      break;
+    }
+    }
+  });
+
+  // Quiescent: the live list holds each live element once, and size()
+  // agrees
+  std::vector<bool> listed_at(SLOTS, false);
+  std::size_t listed = 0;
+
+  arr.for_each_live([&](std::size_t i, const Item&)
+  {
+    STRESS_CHECK(!listed_at[i]);
+    listed_at[i] = true;
+    ++listed;
+  });
+
+  std::size_t live = 0;
+  arr.for_each([&](std::size_t, const Item&) { ++live; });
+  STRESS_CHECK(listed == live);
+  STRESS_CHECK(arr.size() == live);
+
+  for (std::size_t i = 0; i < SLOTS; ++i)
+  {
+    arr.erase(i);
+  }
+
+  listed = 0;
+  arr.for_each_live([&](std::size_t, const Item&) { ++listed; });
+  STRESS_CHECK(listed == 0 && arr.size() == 0);
+
+  // Every slot can be filled again
+  for (std::size_t i = 0; i < SLOTS; ++i)
+  {
+    STRESS_CHECK(arr.insert(Item{ "item-with-a-long-enough-name-0", 0 }));
+  }
+
+  return stress::report("live_array_stress");
+}
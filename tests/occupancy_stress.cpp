@@ -0,0 +1,126 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Array with a Safe_Occupancy feed under concurrent insert/erase/
+// replace/transactions, pinned erases and sample() draws; once quiescent the
+// bits must match the live slots exactly. Build as in stress.h.
+
+#include "safe_array.h"
+#include "safe_occupancy.h"
+#include "stress.h"
+
+#include <string>
+
+constexpr std::size_t N = 256;
+using Array = Safe_Array<std::string, N, Safe_Occupancy<N>>;
+
+static std::string value_for(std::size_t n)
+{
+  return "element-with-a-long-enough-payload-" + std::to_string(n);
+}
+
+static bool well_formed(const std::string& s)
+{
+  return s.compare(0, 35, value_for(0), 0, 35) == 0;
+}
+
+// An erased element a Guard still pins keeps its bit until released, and
+// sample() never hands it out
+static void pinned_erase()
+{
+  Array arr;
+  std::mt19937_64 rng(1);
+  auto r = arr.insert(value_for(1));
+  auto g = arr.acquire(r->index);
+
+  STRESS_CHECK(arr.erase(r->index));
+  STRESS_CHECK(arr.changes().live() == 1);
+  STRESS_CHECK(!arr.sample(rng));
+
+  g.reset();
+  STRESS_CHECK(arr.changes().live() == 0);
+}
+
+int main(int argc, char** argv)
+{
+  pinned_erase();
+
+  Array arr;
+
+  stress::run(6, stress::duration(argc, argv), [&](std::size_t, std::mt19937_64& rng)
+  {
+    std::size_t idx = rng() % arr.capacity();
+
+    switch (rng() % 7)
+    {
+    case 0:
+    case 1:
+      arr.insert(value_for(rng() % 1000));
+      break;
+
+    case 2:
+      arr.erase(idx);
+      break;
+
+    case 3:
+      arr.replace(idx, value_for(rng() % 1000));
+      break;
+
+    case 4:
+      // Erase under a pin, so the slot is freed by the Guard's release
+      if (auto g = arr.acquire(idx))
+      {
+        arr.erase(idx);
+        STRESS_CHECK(well_formed(**g));
+      }
+      break;
+
+    case 5:
+    {
+      auto txn = arr.transaction();
+      txn.erase(idx);
+      txn.insert(value_for(rng() % 1000));
+
+      // Else dropped uncommitted: rolled back, the staged slot freed again
+      if (rng() % 4 != 0)
+      {
+        txn.commit();
+      }
+      break;
+    }
+
+    default:
+      if (auto s = arr.sample(rng))
+      {
+        STRESS_CHECK(s->index < arr.capacity());
+      }
+      break;
+    }
+  });
+
+  // Quiescent: a bit is set exactly for every live slot
+  STRESS_CHECK(arr.changes().live() == arr.size());
+
+  std::mt19937_64 rng(7);
+
+  if (arr.size() != 0)
+  {
+    for (std::size_t k = 0; k < 1000; ++k)
+    {
+      auto s = arr.sample(rng);
+      STRESS_CHECK(s && well_formed(s->value));
+    }
+  }
+
+  for (std::size_t i = 0; i < arr.capacity(); ++i)
+  {
+    arr.erase(i);
+  }
+
+  STRESS_CHECK(arr.changes().live() == 0);
+  STRESS_CHECK(!arr.sample(rng));
+
+  return stress::report("occupancy_stress");
+}
@@ -0,0 +1,145 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Ordered_Array under concurrent insert/erase/lower_bound/range/ordered
+// walks with std::string elements, on a small array so slots are recycled
+// while searches still pass through them. Build as in stress.h.
+
+#include "safe_ordered_array.h"
+#include "stress.h"
+
+#include <string>
+
+static std::string key_for(std::size_t n)
+{
+  char digits[8];
+  std::snprintf(digits, sizeof(digits), "%04zu", n);
+  return std::string("ordered-key-long-enough-to-allocate-") + digits;
+}
+
+int main(int argc, char** argv)
+{
+  constexpr std::size_t SLOTS = 64;
+  constexpr std::size_t KEYS = 256;
+  Safe_Ordered_Array<std::string, SLOTS> arr;
+  std::atomic<std::size_t> inserted{ 0 };
+  std::atomic<std::size_t> erased{ 0 };
+
+  stress::run(6, stress::duration(argc, argv), [&](std::size_t, std::mt19937_64& rng)
+  {
+    switch (rng() % 5)
+    {
+    case 0:
+    case 1:
+      if (arr.insert(key_for(rng() % KEYS)))
+      {
+        inserted.fetch_add(1);
+      }
+      break;
+
+    case 2:
+      // Often lands on an element still being linked
+      if (arr.erase(rng() % SLOTS))
+      {
+        erased.fetch_add(1);
+      }
+      break;
+
+    case 3:
+    {
+      std::string first = key_for(rng() % KEYS);
+      std::string last = key_for(rng() % KEYS);
+      std::string prev;
+
+      arr.range(first, last, [&](std::size_t, const std::string& value)
+      {
+        STRESS_CHECK(value >= first && value < last);
+        STRESS_CHECK(prev <= value);
+        prev = value;
+      });
+      break;
+    }
+
+    default:
+    {
+      std::string prev;
+
+      arr.for_each_ordered([&](std::size_t, const std::string& value)
+      {
+        STRESS_CHECK(value.size() == key_for(0).size());
+        STRESS_CHECK(prev <= value);
+        prev = value;
+      });
+      break;
+    }
+    }
+  });
+
+  // Quiescent: the ordered walk sees exactly the live elements, sorted
+  std::size_t ordered = 0;
+  std::string prev;
+
+  arr.for_each_ordered([&](std::size_t i, const std::string& value)
+  {
+    STRESS_CHECK(prev <= value);
+    STRESS_CHECK(arr.at(i) && &arr.at(i)->value == &value);
+    prev = value;
+    ++ordered;
+  });
+
+  std::size_t live = 0;
+  arr.for_each([&](std::size_t, const std::string&) { ++live; });
+  STRESS_CHECK(ordered == live);
+
+  // An erase that reported success really removed its element
+  STRESS_CHECK(live == inserted.load() - erased.load());
+
+  for (std::size_t i = 0; i < SLOTS; ++i)
+  {
+    arr.erase(i);
+  }
+
+  STRESS_CHECK(arr.size() == 0);
+
+  // Erase elements the moment they are published: the freed slot is reused
+  // first, so erases keep landing on inserts still linking their element
+  std::atomic<std::size_t> latest{ 0 };
+  inserted.store(0);
+  erased.store(0);
+
+  stress::run(4, stress::duration(argc, argv) / 2, [&](std::size_t t, std::mt19937_64& rng)
+  {
+    if (t < 2)
+    {
+      if (auto r = arr.insert(key_for(rng() % KEYS)))
+      {
+        inserted.fetch_add(1);
+        latest.store(r->index);
+      }
+    }
+    else if (arr.erase(latest.load()))
+    {
+      erased.fetch_add(1);
+    }
+  });
+
+  live = 0;
+  arr.for_each([&](std::size_t i, const std::string&)
+  {
+    STRESS_CHECK(arr.at(i));
+    ++live;
+  });
+
+  STRESS_CHECK(live == inserted.load() - erased.load());
+
+  for (std::size_t i = 0; i < SLOTS; ++i)
+  {
+    arr.erase(i);
+  }
+
+  STRESS_CHECK(arr.size() == 0);
+  STRESS_CHECK(!arr.lower_bound(std::string()));
+  return stress::report("ordered_array_stress");
+}
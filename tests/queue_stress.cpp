@@ -0,0 +1,125 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Queue with std::string elements under concurrent producers and
+// consumers, single and bulk: nothing lost or duplicated, and each consumer
+// sees every producer's elements in order. Build as in stress.h.
+
+#include "safe_queue.h"
+#include "stress.h"
+
+#include <array>
+#include <string>
+
+constexpr std::size_t PRODUCERS = 3;
+constexpr std::size_t CONSUMERS = 3;
+
+using Queue = Safe_Queue<std::string, 64>;
+
+// Producer and sequence number, padded past the small-string buffer
+static std::string value_for(std::size_t producer, std::uint64_t seq)
+{
+  return std::to_string(producer) + ":" + std::to_string(seq) +
+    ":element-with-a-long-enough-payload";
+}
+
+static bool parse(const std::string& s, std::size_t& producer, std::uint64_t& seq)
+{
+  std::size_t colon = s.find(':');
+
+  if (colon == std::string::npos)
+  {
+    return false;
+  }
+
+  producer = std::stoul(s.substr(0, colon));
+  seq = std::stoull(s.substr(colon + 1));
+  return producer < PRODUCERS;
+}
+
+int main(int argc, char** argv)
+{
+  Queue queue;
+  std::array<std::uint64_t, PRODUCERS> produced{};
+  std::array<std::array<std::uint64_t, PRODUCERS>, CONSUMERS> last{};
+  std::atomic<std::uint64_t> consumed{ 0 };
+
+  auto check = [&](std::size_t consumer, const std::string& s)
+  {
+    std::size_t producer;
+    std::uint64_t seq;
+
+    if (!parse(s, producer, seq))
+    {
+      STRESS_CHECK(!"malformed element");
+      return;
+    }
+
+    // Sequence numbers start at 1, so 0 means nothing seen yet
+    STRESS_CHECK(seq > last[consumer][producer]);
+    last[consumer][producer] = seq;
+    consumed.fetch_add(1, std::memory_order_relaxed);
+  };
+
+  stress::run(PRODUCERS + CONSUMERS, stress::duration(argc, argv), [&](std::size_t t, std::mt19937_64& rng)
+  {
+    if (t < PRODUCERS)
+    {
+      if (rng() % 4 == 0)
+      {
+        std::string batch[8];
+
+        for (std::size_t i = 0; i < 8; ++i)
+        {
+          batch[i] = value_for(t, produced[t] + 1 + i);
+        }
+
+        produced[t] += queue.enqueue_bulk(batch, 8);
+      }
+      else if (queue.enqueue(value_for(t, produced[t] + 1)))
+      {
+        ++produced[t];
+      }
+
+      return;
+    }
+
+    std::size_t consumer = t - PRODUCERS;
+
+    if (rng() % 4 == 0)
+    {
+      std::string batch[8];
+      std::size_t n = queue.dequeue_bulk(batch, 8);
+
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        check(consumer, batch[i]);
+      }
+    }
+    else if (auto s = queue.dequeue())
+    {
+      check(consumer, *s);
+    }
+  });
+
+  // Quiescent: whatever is left drains in order, and every element produced
+  // was consumed exactly once
+  while (auto s = queue.dequeue())
+  {
+    check(0, *s);
+  }
+
+  std::uint64_t total = 0;
+
+  for (std::uint64_t n : produced)
+  {
+    total += n;
+  }
+
+  STRESS_CHECK(consumed.load() == total);
+  STRESS_CHECK(queue.size() == 0);
+
+  return stress::report("queue_stress");
+}
@@ -0,0 +1,217 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Array under concurrent insert/erase/replace/acquire/transactions with
+// std::string elements, plus wait_change() followers. Build as in stress.h.
+
+#include "safe_array.h"
+#include "stress.h"
+
+#include <string>
+
+using Array = Safe_Array<std::string, 32>;
+
+static std::string value_for(std::size_t n)
+{
+  return "element-with-a-long-enough-payload-" + std::to_string(n);
+}
+
+static bool well_formed(const std::string& s)
+{
+  return s.compare(0, 35, value_for(0), 0, 35) == 0;
+}
+
+// A Guard pinning an erased element keeps its slot REMOVING; following the
+// slot must park, not return over and over
+static void follow_pinned_erase()
+{
+  Array arr;
+  auto r = arr.insert(value_for(1));
+  std::size_t idx = r->index;
+  auto g = arr.acquire(idx);
+  Safe_Slot::Word gen = arr.generation(idx);
+
+  STRESS_CHECK(arr.erase(idx));
+
+  std::atomic<bool> done{ false };
+  std::atomic<std::size_t> returns{ 0 };
+
+  std::thread follower([&]
+  {
+    Safe_Slot::Word seen = gen;
+
+    while (!done.load())
+    {
+      seen = arr.wait_change(idx, seen);
+      returns.fetch_add(1);
+    }
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  STRESS_CHECK(returns.load() <= 1);
+  STRESS_CHECK(**g == value_for(1)); // Still pinned
+  g.reset();
+
+  // Wake the follower: fill the slot again (the freed slot is reused first)
+  done.store(true);
+  auto again = arr.insert(value_for(2));
+  STRESS_CHECK(again && again->index == idx);
+  follower.join();
+}
+
+// A replaced element gives its spare slot back once the old value is
+// released, so replaces never eat into the capacity for long
+static void replace_frees_spare()
+{
+  Safe_Array<std::string, 4> arr;
+  arr.insert(value_for(1));
+  arr.insert(value_for(2));
+
+  STRESS_CHECK(arr.replace(0, value_for(10)));
+  STRESS_CHECK(arr.replace(1, value_for(20)));
+  STRESS_CHECK(arr.insert(value_for(3)));
+  STRESS_CHECK(arr.insert(value_for(4)));
+  STRESS_CHECK(arr.size() == arr.capacity());
+
+  // Full: no spare slot to build a replacement in
+  STRESS_CHECK(!arr.replace(0, value_for(11)));
+  STRESS_CHECK(arr.at(0)->value == value_for(10));
+
+  // A pinned old value keeps the spare slot until its Guard is released
+  arr.erase(3);
+  auto g = arr.acquire(0);
+  STRESS_CHECK(arr.replace(0, value_for(12)));
+  STRESS_CHECK(!arr.insert(value_for(5)));
+  STRESS_CHECK(**g == value_for(10));
+
+  g.reset();
+  STRESS_CHECK(arr.at(0)->value == value_for(12));
+  STRESS_CHECK(arr.insert(value_for(5)));
+  STRESS_CHECK(arr.size() == arr.exact_size());
+}
+
+int main(int argc, char** argv)
+{
+  follow_pinned_erase();
+  replace_frees_spare();
+
+  Array arr;
+  std::atomic<bool> stop{ false };
+  std::vector<std::thread> followers;
+
+  for (std::size_t t = 0; t < 2; ++t)
+  {
+    followers.emplace_back([&, t]
+    {
+      std::size_t idx = t;
+      Safe_Slot::Word seen = arr.generation(idx);
+
+      while (!stop.load())
+      {
+        Safe_Slot::Word next = arr.wait_change(idx, seen);
+        STRESS_CHECK(next != seen);
+        seen = next;
+
+        if (auto g = arr.acquire(idx))
+        {
+          STRESS_CHECK(well_formed(**g));
+        }
+      }
+    });
+  }
+
+  stress::run(6, stress::duration(argc, argv), [&](std::size_t, std::mt19937_64& rng)
+  {
+    std::size_t idx = rng() % arr.capacity();
+
+    switch (rng() % 7)
+    {
+    case 0:
+      arr.insert(value_for(rng() % 1000));
+      break;
+
+    case 1:
+      arr.erase(idx);
+      break;
+
+    case 2:
+      arr.replace(idx, value_for(rng() % 1000));
+      break;
+
+    case 3:
+      if (auto g = arr.acquire(idx))
+      {
+        STRESS_CHECK(g->index() == idx);
+        STRESS_CHECK(well_formed(**g));
+      }
+      break;
+
+    case 4:
+    {
+      auto txn = arr.transaction();
+      txn.erase(idx);
+      txn.insert(value_for(rng() % 1000));
+      txn.commit();
+      break;
+    }
+
+    case 5:
+    {
+      // The predicate reads values, so it must only ever see pinned ones
+      std::string key = value_for(rng() % 1000);
+
+      if (auto g = arr.acquire_if([&](const std::string& s) { return s == key; }))
+      {
+        STRESS_CHECK(**g == key);
+      }
+      break;
+    }
+
+    default:
+      arr.for_each([&](std::size_t i, const std::string&)
+      {
+        STRESS_CHECK(i < arr.capacity());
+      });
+      break;
+    }
+  });
+
+  // Wake the followers: fill every slot, then empty them all, so each one
+  // changes at least once more
+  stop.store(true);
+
+  while (arr.insert(value_for(0)))
+  {
+  }
+
+  // Every spare slot of a replace was given back
+  STRESS_CHECK(arr.size() == arr.capacity());
+
+  for (std::size_t i = 0; i < arr.capacity(); ++i)
+  {
+    arr.erase(i);
+  }
+
+  for (auto& f : followers)
+  {
+    f.join();
+  }
+
+  for (std::size_t i = 0; i < arr.capacity() / 2; ++i)
+  {
+    STRESS_CHECK(arr.insert(value_for(i)));
+  }
+
+  // Quiescent: the counters agree with a scan
+  STRESS_CHECK(arr.size() == arr.exact_size());
+  STRESS_CHECK(arr.size() == arr.approx_size());
+
+  arr.for_each([&](std::size_t, const std::string& value)
+  {
+    STRESS_CHECK(well_formed(value));
+  });
+
+  return stress::report("safe_array_stress");
+}
@@ -0,0 +1,129 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// SINGLE_WRITER Safe_Array with std::string elements: one writer thread
+// inserts, erases, replaces and commits transactions while readers pin
+// elements, so erased slots are also freed on reader threads through the
+// return stack. Once quiescent no slot may be lost. Build as in stress.h.
+
+#include "safe_array.h"
+#include "stress.h"
+
+#include <string>
+
+using Array = Safe_Array<std::string, 32, Safe_No_Feed, Safe_Concurrency::SINGLE_WRITER>;
+
+static std::string value_for(std::size_t n)
+{
+  return "element-with-a-long-enough-payload-" + std::to_string(n);
+}
+
+static bool well_formed(const std::string& s)
+{
+  return s.compare(0, 35, value_for(0), 0, 35) == 0;
+}
+
+int main(int argc, char** argv)
+{
+  Array arr;
+
+  stress::run(5, stress::duration(argc, argv), [&](std::size_t t, std::mt19937_64& rng)
+  {
+    std::size_t idx = rng() % arr.capacity();
+
+    if (t == 0)
+    {
+      // The only writer
+      switch (rng() % 5)
+      {
+      case 0:
+      case 1:
+        arr.insert(value_for(rng() % 1000));
+        break;
+
+      case 2:
+        arr.erase(idx);
+        break;
+
+      case 3:
+        arr.replace(idx, value_for(rng() % 1000));
+        break;
+
+      default:
+      {
+        auto txn = arr.transaction();
+        txn.erase(idx);
+        txn.insert(value_for(rng() % 1000));
+        txn.commit();
+        break;
+      }
+      }
+
+      return;
+    }
+
+    switch (rng() % 3)
+    {
+    case 0:
+      // Hold the pin a while, so the writer's erase often finds it pinned
+      if (auto g = arr.acquire(idx))
+      {
+        std::this_thread::yield();
+        STRESS_CHECK(g->index() == idx);
+        STRESS_CHECK(well_formed(**g));
+      }
+      break;
+
+    case 1:
+    {
+      std::string key = value_for(rng() % 1000);
+
+      if (auto g = arr.acquire_if([&](const std::string& s) { return s == key; }))
+      {
+        STRESS_CHECK(**g == key);
+      }
+      break;
+    }
+
+    default:
+      arr.for_each([&](std::size_t i, const std::string&)
+      {
+        STRESS_CHECK(i < arr.capacity());
+      });
+      break;
+    }
+  });
+
+  // Quiescent: the counters agree with a scan, and every free slot can be
+  // filled, whichever thread freed it (replaced elements have given their
+  // spare slots back); then the same once emptied
+  STRESS_CHECK(arr.size() == arr.exact_size());
+
+  while (arr.insert(value_for(0)))
+  {
+  }
+
+  STRESS_CHECK(arr.size() == arr.capacity());
+
+  for (std::size_t i = 0; i < arr.capacity(); ++i)
+  {
+    arr.erase(i);
+  }
+
+  for (std::size_t i = 0; i < arr.capacity(); ++i)
+  {
+    STRESS_CHECK(arr.insert(value_for(i)));
+  }
+
+  STRESS_CHECK(!arr.insert(value_for(0)));
+  STRESS_CHECK(arr.size() == arr.capacity());
+
+  arr.for_each([&](std::size_t, const std::string& value)
+  {
+    STRESS_CHECK(well_formed(value));
+  });
+
+  return stress::report("single_writer_stress");
+}
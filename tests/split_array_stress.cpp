@@ -0,0 +1,103 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Split_Array under concurrent inserts and erases while scans read
+// the hot column. Build as in stress.h.
+
+#include "safe_split_array.h"
+#include "stress.h"
+
+#include <cstdint>
+
+struct Order
+{
+  std::uint64_t id;
+  std::uint64_t check; // ~id
+  char body[200];
+};
+
+struct Order_Hot
+{
+  std::uint64_t id;
+  std::uint64_t check;
+};
+
+struct Hot_Of_Order
+{
+  Order_Hot operator()(const Order& o) const
+  {
+    return { o.id, o.check };
+  }
+};
+
+using Array = Safe_Split_Array<Order, 32, Hot_Of_Order>;
+
+int main(int argc, char** argv)
+{
+  Array arr;
+
+  // Single-slot inserts never fail while there is room
+  for (std::size_t i = 0; i < arr.capacity(); ++i)
+  {
+    STRESS_CHECK(arr.insert(Order{ i, ~std::uint64_t(i), {} }));
+  }
+
+  STRESS_CHECK(!arr.insert(Order{ 0, ~std::uint64_t(0), {} }));
+
+  stress::run(6, stress::duration(argc, argv), [&](std::size_t, std::mt19937_64& rng)
+  {
+    std::size_t idx = rng() % arr.capacity();
+    std::uint64_t id = rng() % 64;
+
+    switch (rng() % 4)
+    {
+    case 0:
+      arr.insert(Order{ id, ~id, {} });
+      break;
+    case 1:
+      arr.erase(idx);
+      break;
+    case 2:
+      // Results are not read: erases destroy elements unpinned
+      arr.find_if_hot([&](const Order_Hot& h)
+      {
+        STRESS_CHECK(h.check == ~h.id);
+        return h.id == id;
+      });
+      break;
+    default:
+      arr.for_each_hot([&](std::size_t i, const Order_Hot& h)
+      {
+        STRESS_CHECK(i < arr.capacity() && h.check == ~h.id);
+      });
+      break;
+    }
+  });
+
+  // Quiescent: the column matches the elements, slot for slot
+  std::size_t live = 0;
+
+  for (std::size_t i = 0; i < arr.capacity(); ++i)
+  {
+    auto r = arr.at(i);
+    auto h = arr.hot_at(i);
+    STRESS_CHECK(bool(r) == bool(h));
+
+    if (r && h)
+    {
+      STRESS_CHECK(r->value.id == h->id && r->value.check == ~h->id);
+      ++live;
+    }
+  }
+
+  STRESS_CHECK(live == arr.size());
+
+  while (arr.size() < arr.capacity())
+  {
+    STRESS_CHECK(arr.insert(Order{ 7, ~std::uint64_t(7), {} }));
+  }
+
+  return stress::report("split_array_stress");
+}
@@ -0,0 +1,84 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Shared by the stress tests: run a body on several threads for a while and
+// count broken invariants. Each test builds on its own, best under a
+// sanitizer, e.g.
+//
+//   g++ -std=c++20 -O1 -g -fsanitize=address -pthread -I.. hash_map_stress.cpp
+//   g++ -std=c++20 -O1 -g -fsanitize=thread -pthread -I.. hash_map_stress.cpp
+//   ./a.out [milliseconds = 1000]
+
+#ifndef SAFE_ARRAY_STRESS
+#define SAFE_ARRAY_STRESS
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace stress
+{
+  inline std::atomic<std::size_t> failures{ 0 };
+
+  // Run time of each phase, from argv[1] (milliseconds)
+  inline std::chrono::milliseconds duration(int argc, char** argv)
+  {
+    return std::chrono::milliseconds(argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000);
+  }
+
+  // Call body(thread, rng) in a loop on `threads` threads until `time` is up
+  template<typename Body>
+  void run(std::size_t threads, std::chrono::milliseconds time, Body body)
+  {
+    std::atomic<bool> stop{ false };
+    std::vector<std::thread> pool;
+
+    for (std::size_t t = 0; t < threads; ++t)
+    {
+      pool.emplace_back([&, t]
+      {
+        std::mt19937_64 rng(t * 7919 + 1);
+
+        while (!stop.load(std::memory_order_relaxed))
+        {
+          body(t, rng);
+        }
+      });
+    }
+
+    std::this_thread::sleep_for(time);
+    stop.store(true, std::memory_order_relaxed);
+
+    for (auto& thread : pool)
+    {
+      thread.join();
+    }
+  }
+
+  // Print the verdict; use as main's return value
+  inline int report(const char* name)
+  {
+    std::size_t n = failures.load();
+    std::printf("%s: %s (%zu failures)\n", name, n ? "FAILED" : "ok", n);
+    return n ? 1 : 0;
+  }
+}
+
+#define STRESS_CHECK(cond) \
+  do \
+  { \
+    if (!(cond)) \
+    { \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      stress::failures.fetch_add(1); \
+    } \
+  } while (0)
+
+#endif // SAFE_ARRAY_STRESS
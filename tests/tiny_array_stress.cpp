@@ -0,0 +1,84 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Tiny_Array under concurrent insert/erase/replace and reads; checks
+// that values never tear and the free list loses or doubles no slot. Build
+// as in stress.h.
+
+#include "safe_tiny_array.h"
+#include "stress.h"
+
+#include <cstdint>
+#include <vector>
+
+using Array = Safe_Tiny_Array<std::uint32_t, 32>;
+
+// Upper half mirrors the lower, so a torn or misplaced value shows
+static std::uint32_t value_for(std::uint32_t n)
+{
+  return (std::uint32_t(~n & 0xFFFF) << 16) | (n & 0xFFFF);
+}
+
+static bool well_formed(std::uint32_t v)
+{
+  return (v >> 16) == (~v & 0xFFFF);
+}
+
+int main(int argc, char** argv)
+{
+  Array arr;
+
+  stress::run(6, stress::duration(argc, argv), [&](std::size_t, std::mt19937_64& rng)
+  {
+    std::size_t idx = rng() % arr.capacity();
+
+    switch (rng() % 5)
+    {
+    case 0:
+      if (auto r = arr.insert(value_for(std::uint32_t(rng()))))
+      {
+        STRESS_CHECK(r->index < arr.capacity());
+      }
+      break;
+    case 1:
+      arr.erase(idx, rng() % 2 ? arr.generation(idx) : Safe_Slot::ANY_GENERATION);
+      break;
+    case 2:
+      arr.replace(idx, value_for(std::uint32_t(rng())));
+      break;
+    case 3:
+      if (auto r = arr.at(idx))
+      {
+        STRESS_CHECK(well_formed(r->value));
+      }
+      break;
+    default:
+      arr.for_each([&](std::size_t i, std::uint32_t v)
+      {
+        STRESS_CHECK(i < arr.capacity() && well_formed(v));
+      });
+      break;
+    }
+  });
+
+  // Quiescent: every free slot comes back exactly once
+  std::size_t live = arr.size();
+  std::vector<bool> seen(arr.capacity());
+
+  arr.for_each([&](std::size_t i, std::uint32_t)
+  {
+    seen[i] = true;
+  });
+
+  while (auto r = arr.insert(value_for(0)))
+  {
+    STRESS_CHECK(!seen[r->index]);
+    seen[r->index] = true;
+    ++live;
+  }
+
+  STRESS_CHECK(live == arr.capacity() && arr.size() == arr.capacity());
+  return stress::report("tiny_array_stress");
+}
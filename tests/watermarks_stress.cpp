@@ -0,0 +1,100 @@
+// Copyright (c) [2024] [Jovan J. E. Odassius]
+//
+// License: MIT (See the LICENSE file in the root directory)
+// Github: https://github.com/untyper/thread-safe-array
+
+// Safe_Watermarks on a Safe_Array churning around its levels on several
+// threads: every crossing flips its flag, so per level the callbacks
+// alternate up and down, and once quiescent the flags match the size.
+// Build as in stress.h.
+
+#include "safe_array.h"
+#include "safe_watermarks.h"
+#include "stress.h"
+
+#include <array>
+#include <string>
+
+using Array = Safe_Array<std::string, 64>;
+
+constexpr std::size_t LEVELS = 3;
+constexpr std::size_t MARKS[LEVELS] = { 16, 32, 48 };
+
+struct Crossings
+{
+  std::array<std::atomic<std::size_t>, LEVELS> ups{};
+  std::array<std::atomic<std::size_t>, LEVELS> downs{};
+};
+
+struct Count_Crossings
+{
+  Crossings* crossings;
+
+  void operator()(std::size_t level, bool above) const
+  {
+    for (std::size_t i = 0; i < LEVELS; ++i)
+    {
+      if (MARKS[i] == level)
+      {
+        (above ? crossings->ups[i] : crossings->downs[i]).fetch_add(1);
+      }
+    }
+  }
+};
+
+static std::string value_for(std::size_t n)
+{
+  return "element-with-a-long-enough-payload-" + std::to_string(n);
+}
+
+int main(int argc, char** argv)
+{
+  Array arr;
+  Crossings crossings;
+  Safe_Watermarks<Count_Crossings> marks({ MARKS[0], MARKS[1], MARKS[2] },
+    Count_Crossings{ &crossings });
+
+  arr.watch(&marks);
+
+  stress::run(6, stress::duration(argc, argv), [&](std::size_t, std::mt19937_64& rng)
+  {
+    // Drift the fill level up and down across all three marks
+    std::size_t target = MARKS[rng() % LEVELS];
+
+    if (arr.size() < target)
+    {
+      arr.insert(value_for(rng() % 1000));
+    }
+    else
+    {
+      arr.erase(rng() % arr.capacity());
+    }
+
+    for (std::size_t i = 0; i < LEVELS; ++i)
+    {
+      STRESS_CHECK(marks.level(i) == MARKS[i]);
+    }
+  });
+
+  // Quiescent: one more write reports the settled size (this array reports
+  // every change), after which the flags agree with it
+  auto r = arr.insert(value_for(0));
+  STRESS_CHECK(r);
+  arr.erase(r->index);
+
+  for (std::size_t i = 0; i < LEVELS; ++i)
+  {
+    bool above = arr.size() >= MARKS[i];
+    std::size_t ups = crossings.ups[i].load();
+    std::size_t downs = crossings.downs[i].load();
+
+    STRESS_CHECK(marks.above(i) == above);
+    STRESS_CHECK(ups - downs == (above ? 1 : 0));
+    STRESS_CHECK(ups > 0);
+  }
+
+  STRESS_CHECK(marks.above_any() == (arr.size() >= MARKS[0]));
+
+  arr.watch(nullptr);
+  return stress::report("watermarks_stress");
+}